@@ -0,0 +1,50 @@
+#pragma once
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * With glibc every heap allocation, including the ones made inside libobs,
+ * goes through these wrappers so the benchmark can report allocations per
+ * operation. Elsewhere, and under AddressSanitizer which replaces malloc
+ * itself, that column is left empty. Include this from a single file of
+ * each benchmark executable.
+ */
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define BENCH_COUNT_ALLOCS 1
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+static size_t bench_alloc_count = 0;
+
+void *malloc(size_t size)
+{
+	bench_alloc_count++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+	bench_alloc_count++;
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	bench_alloc_count++;
+	return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+	bench_alloc_count++;
+	*ptr = __libc_memalign(alignment, size);
+	return *ptr ? 0 : ENOMEM;
+}
+#else
+#define BENCH_COUNT_ALLOCS 0
+static size_t bench_alloc_count = 0;
+#endif
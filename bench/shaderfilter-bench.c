@@ -0,0 +1,387 @@
+// Micro-benchmarks for the shader preprocessor and the GLSL converter.
+// Only libobs utility code is used, so no OBS graphics device is needed.
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench-alloc.h"
+#include "shader-convert.h"
+#include "shader-preprocess.h"
+
+#ifndef SHADERFILTER_EXAMPLES_DIR
+#define SHADERFILTER_EXAMPLES_DIR "data/examples"
+#endif
+
+struct bench_input {
+	char *name;
+	char *path; /* preprocessor cases */
+	char *text; /* converter cases */
+	size_t size;
+};
+
+struct bench_case {
+	const char *name;
+	DARRAY(struct bench_input) inputs;
+	bool convert;
+};
+
+struct bench_result {
+	size_t ops;
+	size_t failed;
+	uint64_t total_ns;
+	uint64_t p50_ns;
+	uint64_t p99_ns;
+	double bytes_per_op;
+	double allocs_per_op;
+	long leaked;
+};
+
+static int bench_iterations = 30;
+static const char *bench_filter = NULL;
+static bool bench_verbose = false;
+
+static void bench_log_handler(int lvl, const char *msg, va_list args, void *param)
+{
+	UNUSED_PARAMETER(param);
+	if (lvl > LOG_ERROR && !bench_verbose)
+		return;
+	vfprintf(stderr, msg, args);
+	fputc('\n', stderr);
+}
+
+static int bench_compare_ns(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static uint64_t bench_percentile(const uint64_t *sorted, size_t num, double p)
+{
+	size_t i = (size_t)(p * (double)(num - 1) + 0.5);
+	return sorted[i < num ? i : num - 1];
+}
+
+static bool bench_run_input(const struct bench_case *bc, const struct bench_input *in)
+{
+	if (bc->convert) {
+		char *converted = shader_convert_glsl(in->text);
+		bfree(converted);
+		return converted != NULL;
+	}
+	char *text = load_shader_from_file(in->path, NULL);
+	bfree(text);
+	return text != NULL;
+}
+
+static void bench_run_case(const struct bench_case *bc, struct bench_result *res)
+{
+	memset(res, 0, sizeof(*res));
+	size_t num = bc->inputs.num * (size_t)bench_iterations;
+	uint64_t *samples = bmalloc(num * sizeof(uint64_t));
+
+	/* warm up the page cache and the allocator */
+	for (size_t i = 0; i < bc->inputs.num; i++)
+		bench_run_input(bc, &bc->inputs.array[i]);
+
+	long live_before = bnum_allocs();
+	size_t allocs_before = bench_alloc_count;
+	uint64_t bytes = 0;
+	for (int it = 0; it < bench_iterations; it++) {
+		for (size_t i = 0; i < bc->inputs.num; i++) {
+			const struct bench_input *in = &bc->inputs.array[i];
+			uint64_t start = os_gettime_ns();
+			bool ok = bench_run_input(bc, in);
+			uint64_t ns = os_gettime_ns() - start;
+			samples[res->ops++] = ns;
+			res->total_ns += ns;
+			bytes += in->size;
+			if (!ok && it == 0)
+				res->failed++;
+		}
+	}
+	res->allocs_per_op = (double)(bench_alloc_count - allocs_before) / (double)res->ops;
+	res->leaked = bnum_allocs() - live_before;
+	res->bytes_per_op = (double)bytes / (double)res->ops;
+
+	qsort(samples, res->ops, sizeof(uint64_t), bench_compare_ns);
+	res->p50_ns = bench_percentile(samples, res->ops, 0.50);
+	res->p99_ns = bench_percentile(samples, res->ops, 0.99);
+	bfree(samples);
+}
+
+static void bench_print_result(const struct bench_case *bc, const struct bench_result *res)
+{
+	double seconds = (double)res->total_ns / 1e9;
+	double mb_per_s = seconds > 0.0 ? res->bytes_per_op * (double)res->ops / seconds / (1024.0 * 1024.0) : 0.0;
+	char allocs[32] = "-";
+	if (BENCH_COUNT_ALLOCS)
+		snprintf(allocs, sizeof(allocs), "%.1f", res->allocs_per_op);
+
+	printf("%-26s %5zu %8zu %10.1f %10.1f %10.1f %9.1f %10s %6ld", bc->name, bc->inputs.num, res->ops,
+	       res->bytes_per_op / 1024.0, res->p50_ns / 1000.0, res->p99_ns / 1000.0, mb_per_s, allocs, res->leaked);
+	if (res->failed)
+		printf("  (%zu inputs gave no output)", res->failed);
+	printf("\n");
+}
+
+static void bench_add_input(struct bench_case *bc, const char *name, const char *path, char *text)
+{
+	struct bench_input *in = da_push_back_new(bc->inputs);
+	in->name = bstrdup(name);
+	in->path = path ? bstrdup(path) : NULL;
+	in->text = text;
+	in->size = text ? strlen(text) : 0;
+}
+
+static void bench_free_case(struct bench_case *bc)
+{
+	for (size_t i = 0; i < bc->inputs.num; i++) {
+		bfree(bc->inputs.array[i].name);
+		bfree(bc->inputs.array[i].path);
+		bfree(bc->inputs.array[i].text);
+	}
+	da_free(bc->inputs);
+}
+
+static bool bench_is_shader_file(const char *name)
+{
+	const char *ext = strrchr(name, '.');
+	return ext && (strcmp(ext, ".shader") == 0 || strcmp(ext, ".effect") == 0 || strcmp(ext, ".hlsl") == 0);
+}
+
+/* Both example cases keep the file text: the converter needs it and the
+ * preprocessor case uses its size for throughput. */
+static void bench_load_examples(struct bench_case *preprocess, struct bench_case *convert, const char *dir)
+{
+	os_dir_t *d = os_opendir(dir);
+	if (!d) {
+		fprintf(stderr, "cannot open examples directory: %s\n", dir);
+		return;
+	}
+	struct os_dirent *ent;
+	struct dstr path = {0};
+	while ((ent = os_readdir(d)) != NULL) {
+		if (ent->directory || !bench_is_shader_file(ent->d_name))
+			continue;
+		dstr_printf(&path, "%s/%s", dir, ent->d_name);
+		char *text = os_quick_read_utf8_file(path.array);
+		if (!text)
+			continue;
+		bench_add_input(preprocess, ent->d_name, path.array, bstrdup(text));
+		bench_add_input(convert, ent->d_name, NULL, text);
+	}
+	dstr_free(&path);
+	os_closedir(d);
+}
+
+/* A Shadertoy source with `blocks` helper functions (about 330 bytes each)
+ * that exercise every rewrite rule of the converter. */
+static char *bench_generate_shadertoy(int blocks)
+{
+	struct dstr s = {0};
+	dstr_reserve(&s, (size_t)blocks * 340 + 1024);
+	dstr_cat(&s, "#define PI 3.14159\nconst float speed = 2.0;\nfloat glow, fade;\n");
+	for (int i = 0; i < blocks; i++) {
+		dstr_catf(&s,
+			  "mat2 rot%d(float a) { float c = cos(a), s = sin(a); return mat2(c, -s, s, c); }\n"
+			  "vec3 shade%d(vec2 p, float t) {\n"
+			  "    p *= rot%d(t);\n"
+			  "    vec3 col = vec3(fract(p.x + iTime));\n"
+			  "    col = mix(col, vec3(1.0, 0.0, 0.0), step(0.0, length(p) - 0.3));\n"
+			  "    float a = atan(p.y, p.x);\n"
+			  "    return col * vec3(a) + texture(iChannel0, p).rgb;\n"
+			  "}\n\n",
+			  i, i, i);
+	}
+	dstr_cat(&s, "void mainImage( out vec4 fragColor, in vec2 fragCoord )\n"
+		     "{\n"
+		     "    vec2 uv = fragCoord.xy / iResolution.xy;\n"
+		     "    vec3 col = shade0(uv, iTime);\n"
+		     "#if 0\n"
+		     "    col = vec3(0.0);\n"
+		     "#endif\n"
+		     "    fragColor = vec4(col, 1.0);\n"
+		     "}\n");
+	return s.array;
+}
+
+static bool bench_write_file(const char *path, const char *text)
+{
+	if (!os_quick_write_utf8_file(path, text, strlen(text), false)) {
+		fprintf(stderr, "cannot write %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Writes two include trees into dir: a chain where each file includes the
+ * next one, and a root that includes many sibling files plus the same
+ * shared header from each of them.
+ */
+static void bench_write_include_trees(struct bench_case *bc, const char *dir, int depth, int width)
+{
+	struct dstr path = {0};
+	struct dstr text = {0};
+	const char *body = "float4 helper(float2 uv) { return image.Sample(textureSampler, uv) * 0.5; }\n";
+
+	for (int i = 0; i < depth; i++) {
+		dstr_free(&text);
+		if (i + 1 < depth)
+			dstr_printf(&text, "#include \"chain%d.hlsl\"\n", i + 1);
+		for (int j = 0; j < 16; j++)
+			dstr_cat(&text, body);
+		dstr_printf(&path, "%s/chain%d.hlsl", dir, i);
+		bench_write_file(path.array, text.array);
+	}
+	dstr_printf(&path, "%s/chain0.hlsl", dir);
+	bench_add_input(bc, "chain", path.array, NULL);
+
+	dstr_printf(&path, "%s/shared.hlsl", dir);
+	bench_write_file(path.array, body);
+	dstr_free(&text);
+	for (int i = 0; i < width; i++) {
+		struct dstr leaf = {0};
+		dstr_copy(&leaf, "#include \"shared.hlsl\"\n");
+		for (int j = 0; j < 16; j++)
+			dstr_cat(&leaf, body);
+		dstr_printf(&path, "%s/leaf%d.hlsl", dir, i);
+		bench_write_file(path.array, leaf.array);
+		dstr_free(&leaf);
+		dstr_catf(&text, "#include \"leaf%d.hlsl\"\n", i);
+	}
+	dstr_cat(&text, "float4 mainImage(VertData v_in) : TARGET { return helper(v_in.uv); }\n");
+	dstr_printf(&path, "%s/fanout.hlsl", dir);
+	bench_write_file(path.array, text.array);
+	bench_add_input(bc, "fanout", path.array, NULL);
+
+	dstr_free(&path);
+	dstr_free(&text);
+}
+
+/* Sizes come from the expanded output, which is what the preprocessor emits. */
+static void bench_measure_preprocess_sizes(struct bench_case *bc)
+{
+	for (size_t i = 0; i < bc->inputs.num; i++) {
+		struct bench_input *in = &bc->inputs.array[i];
+		if (in->size)
+			continue;
+		char *text = load_shader_from_file(in->path, NULL);
+		in->size = text ? strlen(text) : 0;
+		bfree(text);
+	}
+}
+
+static void bench_remove_dir(const char *dir)
+{
+	os_dir_t *d = os_opendir(dir);
+	if (!d)
+		return;
+	struct os_dirent *ent;
+	struct dstr path = {0};
+	while ((ent = os_readdir(d)) != NULL) {
+		if (ent->directory)
+			continue;
+		dstr_printf(&path, "%s/%s", dir, ent->d_name);
+		os_unlink(path.array);
+	}
+	dstr_free(&path);
+	os_closedir(d);
+	os_rmdir(dir);
+}
+
+static const char *bench_temp_root(void)
+{
+	const char *vars[] = {"TMPDIR", "TEMP", "TMP"};
+	for (size_t i = 0; i < sizeof(vars) / sizeof(vars[0]); i++) {
+		const char *value = getenv(vars[i]);
+		if (value && *value)
+			return value;
+	}
+	return "/tmp";
+}
+
+static void bench_usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [-n iterations] [-f filter] [-v] [examples_dir]\n"
+		"  -n  iterations over each case's inputs (default 30)\n"
+		"  -f  only run cases whose name contains filter\n"
+		"  -v  print warnings logged by the code under test\n",
+		argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *examples_dir = SHADERFILTER_EXAMPLES_DIR;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			bench_iterations = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			bench_filter = argv[++i];
+		} else if (strcmp(argv[i], "-v") == 0) {
+			bench_verbose = true;
+		} else if (argv[i][0] == '-') {
+			bench_usage(argv[0]);
+			return 1;
+		} else {
+			examples_dir = argv[i];
+		}
+	}
+	if (bench_iterations < 1) {
+		bench_usage(argv[0]);
+		return 1;
+	}
+	base_set_log_handler(bench_log_handler, NULL);
+
+	struct bench_case cases[] = {
+		{.name = "preprocess/examples"},
+		{.name = "preprocess/include-trees"},
+		{.name = "convert/examples", .convert = true},
+		{.name = "convert/shadertoy-64k", .convert = true},
+		{.name = "convert/shadertoy-256k", .convert = true},
+		{.name = "convert/shadertoy-1m", .convert = true},
+	};
+	const size_t num_cases = sizeof(cases) / sizeof(cases[0]);
+	for (size_t i = 0; i < num_cases; i++)
+		da_init(cases[i].inputs);
+
+	bench_load_examples(&cases[0], &cases[2], examples_dir);
+
+	struct dstr temp_dir = {0};
+	dstr_printf(&temp_dir, "%s/shaderfilter-bench-%llu", bench_temp_root(), (unsigned long long)os_gettime_ns());
+	if (os_mkdirs(temp_dir.array) != MKDIR_ERROR)
+		bench_write_include_trees(&cases[1], temp_dir.array, 64, 256);
+	bench_measure_preprocess_sizes(&cases[1]);
+
+	bench_add_input(&cases[3], "shadertoy-200", NULL, bench_generate_shadertoy(200));
+	bench_add_input(&cases[4], "shadertoy-800", NULL, bench_generate_shadertoy(800));
+	bench_add_input(&cases[5], "shadertoy-3200", NULL, bench_generate_shadertoy(3200));
+
+	printf("%-26s %5s %8s %10s %10s %10s %9s %10s %6s\n", "case", "files", "ops", "KiB/op", "p50 us", "p99 us", "MiB/s",
+	       "allocs/op", "leaked");
+	int status = 0;
+	for (size_t i = 0; i < num_cases; i++) {
+		struct bench_case *bc = &cases[i];
+		if (!bc->inputs.num || (bench_filter && !strstr(bc->name, bench_filter)))
+			continue;
+		struct bench_result res;
+		bench_run_case(bc, &res);
+		bench_print_result(bc, &res);
+		if (res.leaked)
+			status = 1;
+	}
+
+	for (size_t i = 0; i < num_cases; i++)
+		bench_free_case(&cases[i]);
+	bench_remove_dir(temp_dir.array);
+	dstr_free(&temp_dir);
+	return status;
+}
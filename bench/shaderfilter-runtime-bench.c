@@ -0,0 +1,738 @@
+// Measures the CPU side of the per-frame callbacks of the shader filter.
+// The plugin is compiled into this file and the graphics and source calls it
+// makes are replaced by the mocks below, so no OBS instance or GPU is needed.
+#include "bench-alloc.h"
+#include "../obs-shaderfilter.c"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifndef SHADERFILTER_DATA_DIR
+#define SHADERFILTER_DATA_DIR "data"
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Graphics mocks                                                            */
+
+struct gs_effect_param {
+	char *name;
+	enum gs_shader_param_type type;
+	size_t size;
+	void *default_value;
+	size_t default_size;
+	uint8_t value[64];
+	gs_texture_t *texture;
+};
+
+struct gs_effect {
+	DARRAY(struct gs_effect_param) params;
+};
+
+static size_t bench_uniform_uploads = 0;
+
+static const struct {
+	const char *name;
+	enum gs_shader_param_type type;
+	size_t size;
+} bench_param_types[] = {
+	{"bool", GS_SHADER_PARAM_BOOL, sizeof(int)},
+	{"float", GS_SHADER_PARAM_FLOAT, sizeof(float)},
+	{"int", GS_SHADER_PARAM_INT, sizeof(int)},
+	{"float2", GS_SHADER_PARAM_VEC2, sizeof(struct vec2)},
+	{"float3", GS_SHADER_PARAM_VEC3, sizeof(struct vec3)},
+	{"float4", GS_SHADER_PARAM_VEC4, sizeof(struct vec4)},
+	{"float4x4", GS_SHADER_PARAM_MATRIX4X4, sizeof(float) * 16},
+	{"texture2d", GS_SHADER_PARAM_TEXTURE, 0},
+	{"string", GS_SHADER_PARAM_STRING, 0},
+};
+
+static const char *bench_skip_space(const char *cur)
+{
+	while (*cur == ' ' || *cur == '\t' || *cur == '\r' || *cur == '\n')
+		cur++;
+	return cur;
+}
+
+static const char *bench_scan_ident(const char *cur, struct dstr *ident)
+{
+	const char *start = cur;
+	while (is_var_char(*cur))
+		cur++;
+	dstr_ncopy(ident, start, cur - start);
+	return cur;
+}
+
+/* Reads "= value" or "= {v, v, ...}" after a uniform declaration. */
+static void bench_parse_default(struct gs_effect_param *param, const char *cur)
+{
+	if (param->type == GS_SHADER_PARAM_TEXTURE || param->type == GS_SHADER_PARAM_STRING)
+		return;
+	cur = bench_skip_space(cur);
+	if (*cur != '=')
+		return;
+	cur = bench_skip_space(cur + 1);
+	if (*cur == '{')
+		cur++;
+
+	param->default_value = bzalloc(param->size);
+	param->default_size = param->size;
+	if (param->type == GS_SHADER_PARAM_BOOL || param->type == GS_SHADER_PARAM_INT) {
+		int *value = param->default_value;
+		if (strncmp(cur, "true", 4) == 0)
+			*value = 1;
+		else if (strncmp(cur, "false", 5) != 0)
+			*value = atoi(cur);
+		return;
+	}
+	float *values = param->default_value;
+	for (size_t i = 0; i < param->size / sizeof(float); i++) {
+		char *end;
+		values[i] = strtof(cur, &end);
+		cur = bench_skip_space(end);
+		if (*cur != ',')
+			break;
+		cur = bench_skip_space(cur + 1);
+	}
+}
+
+gs_effect_t *gs_effect_create(const char *effect_string, const char *filename, char **error_string)
+{
+	UNUSED_PARAMETER(filename);
+	if (error_string)
+		*error_string = NULL;
+
+	gs_effect_t *effect = bzalloc(sizeof(gs_effect_t));
+	struct dstr ident = {0};
+	bool line_start = true;
+	for (const char *cur = effect_string; *cur; cur++) {
+		if (*cur == '\n') {
+			line_start = true;
+			continue;
+		}
+		if (*cur == ' ' || *cur == '\t')
+			continue;
+		if (!line_start || strncmp(cur, "uniform", 7) != 0 || is_var_char(cur[7])) {
+			line_start = false;
+			continue;
+		}
+		line_start = false;
+
+		cur = bench_scan_ident(bench_skip_space(cur + 7), &ident);
+		size_t type = 0;
+		while (type < OBS_COUNTOF(bench_param_types) && dstr_cmp(&ident, bench_param_types[type].name) != 0)
+			type++;
+		if (type == OBS_COUNTOF(bench_param_types))
+			continue;
+
+		cur = bench_scan_ident(bench_skip_space(cur), &ident);
+		struct gs_effect_param *param = da_push_back_new(effect->params);
+		param->name = bstrdup(ident.array);
+		param->type = bench_param_types[type].type;
+		param->size = bench_param_types[type].size;
+		bench_parse_default(param, cur);
+		cur--;
+	}
+	dstr_free(&ident);
+	return effect;
+}
+
+void gs_effect_destroy(gs_effect_t *effect)
+{
+	if (!effect)
+		return;
+	for (size_t i = 0; i < effect->params.num; i++) {
+		bfree(effect->params.array[i].name);
+		bfree(effect->params.array[i].default_value);
+	}
+	da_free(effect->params);
+	bfree(effect);
+}
+
+size_t gs_effect_get_num_params(const gs_effect_t *effect)
+{
+	return effect ? effect->params.num : 0;
+}
+
+gs_eparam_t *gs_effect_get_param_by_idx(const gs_effect_t *effect, size_t param)
+{
+	return effect && param < effect->params.num ? effect->params.array + param : NULL;
+}
+
+gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect, const char *name)
+{
+	for (size_t i = 0; effect && i < effect->params.num; i++) {
+		if (strcmp(effect->params.array[i].name, name) == 0)
+			return effect->params.array + i;
+	}
+	return NULL;
+}
+
+void gs_effect_get_param_info(const gs_eparam_t *param, struct gs_effect_param_info *info)
+{
+	info->name = param->name;
+	info->type = param->type;
+}
+
+size_t gs_param_get_num_annotations(const gs_eparam_t *param)
+{
+	UNUSED_PARAMETER(param);
+	return 0;
+}
+
+gs_eparam_t *gs_param_get_annotation_by_idx(const gs_eparam_t *param, size_t annotation)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(annotation);
+	return NULL;
+}
+
+void *gs_effect_get_default_val(gs_eparam_t *param)
+{
+	if (!param || !param->default_value)
+		return NULL;
+	void *value = bmalloc(param->default_size);
+	memcpy(value, param->default_value, param->default_size);
+	return value;
+}
+
+size_t gs_effect_get_val_size(gs_eparam_t *param)
+{
+	return param ? param->size : 0;
+}
+
+static void bench_set_value(gs_eparam_t *param, const void *value, size_t size)
+{
+	bench_uniform_uploads++;
+	if (size > sizeof(param->value))
+		size = sizeof(param->value);
+	if (value)
+		memcpy(param->value, value, size);
+}
+
+void gs_effect_set_bool(gs_eparam_t *param, bool val)
+{
+	int i = val;
+	bench_set_value(param, &i, sizeof(i));
+}
+
+void gs_effect_set_float(gs_eparam_t *param, float val)
+{
+	bench_set_value(param, &val, sizeof(val));
+}
+
+void gs_effect_set_int(gs_eparam_t *param, int val)
+{
+	bench_set_value(param, &val, sizeof(val));
+}
+
+void gs_effect_set_vec2(gs_eparam_t *param, const struct vec2 *val)
+{
+	bench_set_value(param, val, sizeof(*val));
+}
+
+void gs_effect_set_vec3(gs_eparam_t *param, const struct vec3 *val)
+{
+	bench_set_value(param, val, sizeof(*val));
+}
+
+void gs_effect_set_vec4(gs_eparam_t *param, const struct vec4 *val)
+{
+	bench_set_value(param, val, sizeof(*val));
+}
+
+void gs_effect_set_val(gs_eparam_t *param, const void *val, size_t size)
+{
+	bench_set_value(param, val, size);
+}
+
+void gs_effect_set_texture(gs_eparam_t *param, gs_texture_t *val)
+{
+	bench_uniform_uploads++;
+	param->texture = val;
+}
+
+void gs_effect_set_texture_srgb(gs_eparam_t *param, gs_texture_t *val)
+{
+	gs_effect_set_texture(param, val);
+}
+
+enum gs_device_type gs_get_device_type(void)
+{
+	return GS_DEVICE_OPENGL;
+}
+
+gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender)
+{
+	UNUSED_PARAMETER(texrender);
+	return NULL;
+}
+
+void gs_texrender_destroy(gs_texrender_t *texrender)
+{
+	UNUSED_PARAMETER(texrender);
+}
+
+void gs_vertexbuffer_destroy(gs_vertbuffer_t *vertbuffer)
+{
+	UNUSED_PARAMETER(vertbuffer);
+}
+
+void gs_image_file_init(gs_image_file_t *image, const char *file)
+{
+	UNUSED_PARAMETER(file);
+	memset(image, 0, sizeof(*image));
+}
+
+void gs_image_file_free(gs_image_file_t *image)
+{
+	UNUSED_PARAMETER(image);
+}
+
+void gs_image_file_init_texture(gs_image_file_t *image)
+{
+	UNUSED_PARAMETER(image);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Core and source mocks                                                     */
+
+struct obs_source {
+	obs_data_t *settings;
+};
+
+static struct obs_source bench_parent;
+
+void obs_enter_graphics(void) {}
+
+void obs_leave_graphics(void) {}
+
+/* Stands in for the frame loop: main() runs the callback once per frame. */
+static void (*bench_tick_callback)(void *param, float seconds);
+static void *bench_tick_param;
+
+void obs_add_tick_callback(void (*tick)(void *param, float seconds), void *param)
+{
+	bench_tick_callback = tick;
+	bench_tick_param = param;
+}
+
+void obs_remove_tick_callback(void (*tick)(void *param, float seconds), void *param)
+{
+	UNUSED_PARAMETER(param);
+	if (bench_tick_callback == tick)
+		bench_tick_callback = NULL;
+}
+
+void obs_register_source_s(const struct obs_source_info *info, size_t size)
+{
+	UNUSED_PARAMETER(info);
+	UNUSED_PARAMETER(size);
+}
+
+const char *obs_get_module_data_path(obs_module_t *module)
+{
+	UNUSED_PARAMETER(module);
+	return SHADERFILTER_DATA_DIR;
+}
+
+/* The harness calls the update callback itself. */
+void obs_source_update(obs_source_t *source, obs_data_t *settings)
+{
+	UNUSED_PARAMETER(source);
+	UNUSED_PARAMETER(settings);
+}
+
+void obs_source_update_properties(obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+}
+
+obs_data_t *obs_source_get_settings(const obs_source_t *source)
+{
+	obs_data_addref(source->settings);
+	return source->settings;
+}
+
+obs_source_t *obs_filter_get_target(const obs_source_t *filter)
+{
+	UNUSED_PARAMETER(filter);
+	return &bench_parent;
+}
+
+obs_source_t *obs_filter_get_parent(const obs_source_t *filter)
+{
+	UNUSED_PARAMETER(filter);
+	return &bench_parent;
+}
+
+uint32_t obs_source_get_base_width(obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+	return 1920;
+}
+
+uint32_t obs_source_get_base_height(obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+	return 1080;
+}
+
+bool obs_source_enabled(const obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+	return true;
+}
+
+bool obs_source_active(const obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+	return true;
+}
+
+bool obs_source_showing(const obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+	return true;
+}
+
+void obs_source_skip_video_filter(obs_source_t *filter)
+{
+	UNUSED_PARAMETER(filter);
+}
+
+obs_source_t *obs_get_source_by_name(const char *name)
+{
+	UNUSED_PARAMETER(name);
+	return NULL;
+}
+
+obs_source_t *obs_source_get_ref(obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+	return NULL;
+}
+
+void obs_source_release(obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Harness                                                                   */
+
+static int bench_instances = 200;
+static int bench_params = 40;
+static int bench_frames = 600;
+static int bench_updates = 20;
+static bool bench_verbose = false;
+
+static void bench_log_handler(int lvl, const char *msg, va_list args, void *param)
+{
+	UNUSED_PARAMETER(param);
+	if (lvl > LOG_ERROR && !bench_verbose)
+		return;
+	vfprintf(stderr, msg, args);
+	fputc('\n', stderr);
+}
+
+/* The user params cycle through these types, roughly in the mix of the examples. */
+static const char *const bench_shader_types[] = {
+	"float", "float", "float", "int", "bool", "float2", "float4", "float", "int", "bool",
+};
+
+/*
+ * A shader with bench_params user params, all read by mainImage, plus the
+ * builtin uniforms most examples use.
+ */
+static char *bench_generate_shader(void)
+{
+	struct dstr text = {0};
+	struct dstr body = {0};
+	for (int i = 0; i < bench_params; i++) {
+		const char *type = i % 20 == 19 ? "texture2d" : bench_shader_types[i % OBS_COUNTOF(bench_shader_types)];
+		if (strcmp(type, "float") == 0) {
+			dstr_catf(&text, "uniform float p%d = %d.5;\n", i, i);
+			dstr_catf(&body, "\tc.r += p%d;\n", i);
+		} else if (strcmp(type, "int") == 0) {
+			dstr_catf(&text, "uniform int p%d = %d;\n", i, i);
+			dstr_catf(&body, "\tc.g += p%d;\n", i);
+		} else if (strcmp(type, "bool") == 0) {
+			dstr_catf(&text, "uniform bool p%d = true;\n", i);
+			dstr_catf(&body, "\tif (p%d) c.b += 0.1;\n", i);
+		} else if (strcmp(type, "float2") == 0) {
+			dstr_catf(&text, "uniform float2 p%d = {0.25, 0.75};\n", i);
+			dstr_catf(&body, "\tc.rg += p%d;\n", i);
+		} else if (strcmp(type, "float4") == 0) {
+			dstr_catf(&text, "uniform float4 p%d = {1.0, 0.5, 0.25, 1.0};\n", i);
+			dstr_catf(&body, "\tc *= p%d;\n", i);
+		} else {
+			dstr_catf(&text, "uniform texture2d p%d;\n", i);
+			dstr_catf(&body, "\tc += p%d.Sample(textureSampler, v_in.uv);\n", i);
+		}
+	}
+	dstr_cat(&text, "\nfloat4 mainImage(VertData v_in) : TARGET\n{\n"
+			"\tfloat4 c = image.Sample(textureSampler, v_in.uv * uv_scale + uv_offset);\n"
+			"\tc.a *= sin(elapsed_time) * rand_f + uv_size.x * uv_pixel_interval.x;\n");
+	dstr_cat_dstr(&text, &body);
+	dstr_cat(&text, "\treturn c;\n}\n");
+	dstr_free(&body);
+	return text.array;
+}
+
+/*
+ * L1 data cache read misses of this thread, read around each timed loop. Not
+ * every machine exposes the counter, virtual machines often do not, and then
+ * the column prints "-".
+ */
+static int bench_misses_fd = -1;
+
+static void bench_misses_open(void)
+{
+#ifdef __linux__
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	bench_misses_fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+static uint64_t bench_misses_read(void)
+{
+	uint64_t count = 0;
+#ifdef __linux__
+	if (bench_misses_fd >= 0 && read(bench_misses_fd, &count, sizeof(count)) != sizeof(count))
+		count = 0;
+#endif
+	return count;
+}
+
+static void bench_misses_close(void)
+{
+#ifdef __linux__
+	if (bench_misses_fd >= 0)
+		close(bench_misses_fd);
+#endif
+	bench_misses_fd = -1;
+}
+
+struct bench_instance {
+	struct obs_source source;
+	struct shader_filter_data *filter;
+};
+
+struct bench_stat {
+	const char *name;
+	DARRAY(uint64_t) samples; /* ns per op, one sample per batch */
+	size_t ops;
+	uint64_t total_ns;
+	size_t allocs;
+	size_t uploads;
+	uint64_t misses;
+};
+
+static void bench_stat_add(struct bench_stat *stat, uint64_t ns, size_t ops, size_t allocs, size_t uploads,
+			   uint64_t misses)
+{
+	uint64_t per_op = ns / ops;
+	da_push_back(stat->samples, &per_op);
+	stat->ops += ops;
+	stat->total_ns += ns;
+	stat->allocs += allocs;
+	stat->uploads += uploads;
+	stat->misses += misses;
+}
+
+static int bench_compare_ns(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void bench_stat_print(struct bench_stat *stat)
+{
+	size_t num = stat->samples.num;
+	if (!num)
+		return;
+	qsort(stat->samples.array, num, sizeof(uint64_t), bench_compare_ns);
+	uint64_t p50 = stat->samples.array[(num - 1) / 2];
+	uint64_t p99 = stat->samples.array[(size_t)((double)(num - 1) * 0.99 + 0.5)];
+	char allocs[32] = "-";
+	if (BENCH_COUNT_ALLOCS)
+		snprintf(allocs, sizeof(allocs), "%.2f", (double)stat->allocs / (double)stat->ops);
+	char misses[32] = "-";
+	if (bench_misses_fd >= 0)
+		snprintf(misses, sizeof(misses), "%.1f", (double)stat->misses / (double)stat->ops);
+	printf("%-34s %9zu %9.1f %9llu %9llu %10s %10.2f %11s\n", stat->name, stat->ops,
+	       (double)stat->total_ns / (double)stat->ops, (unsigned long long)p50, (unsigned long long)p99, allocs,
+	       (double)stat->uploads / (double)stat->ops, misses);
+	da_free(stat->samples);
+}
+
+static void bench_usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [-i instances] [-p params] [-n frames] [-u updates] [-v]\n"
+		"  -i  filter instances (default 200)\n"
+		"  -p  user params per instance (default 40)\n"
+		"  -n  frames to tick and set params for (default 600)\n"
+		"  -u  rounds of shader_filter_update over all instances (default 20)\n"
+		"  -v  print warnings logged by the plugin\n",
+		argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+			bench_instances = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			bench_params = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			bench_frames = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+			bench_updates = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-v") == 0) {
+			bench_verbose = true;
+		} else {
+			bench_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (bench_instances < 1 || bench_params < 0 || bench_frames < 1 || bench_updates < 1) {
+		bench_usage(argv[0]);
+		return 1;
+	}
+	base_set_log_handler(bench_log_handler, NULL);
+
+	long live_before = bnum_allocs();
+	obs_module_load();
+	bench_parent.settings = obs_data_create();
+
+	char *shader = bench_generate_shader();
+	struct bench_instance *instances = bzalloc(sizeof(struct bench_instance) * bench_instances);
+	for (int i = 0; i < bench_instances; i++) {
+		obs_data_t *settings = obs_data_create();
+		obs_data_set_bool(settings, "from_file", false);
+		obs_data_set_string(settings, "shader_text", shader);
+		for (int p = 0; p < bench_params; p += 3) {
+			struct dstr name = {0};
+			dstr_printf(&name, "p%d", p);
+			obs_data_set_double(settings, name.array, (double)(i + p) / 100.0);
+			dstr_free(&name);
+		}
+		instances[i].source.settings = settings;
+		instances[i].filter = shader_filter_create(settings, &instances[i].source);
+		shader_filter_update(instances[i].filter, settings);
+	}
+
+	// Let the compile queue finish, then swap the effects in.
+	for (int tries = 0; tries < 1000; tries++) {
+		bool pending = false;
+		for (int i = 0; i < bench_instances; i++) {
+			struct shader_filter_data *filter = instances[i].filter;
+			shader_filter_tick(filter, 0.0f);
+			pending = pending || filter->compile_job;
+		}
+		if (!pending)
+			break;
+		os_sleep_ms(1);
+	}
+	if (!instances[0].filter->effect) {
+		fprintf(stderr, "the benchmark shader did not load\n");
+		return 1;
+	}
+
+	struct bench_stat tick = {.name = "shader_filter_tick"};
+	struct bench_stat params = {.name = "shader_filter_set_effect_params"};
+	struct bench_stat frame = {.name = "frame (per instance)"};
+	struct bench_stat update = {.name = "shader_filter_update"};
+
+	bench_misses_open();
+	for (int f = 0; f < bench_frames; f++) {
+		size_t allocs = bench_alloc_count;
+		uint64_t misses = bench_misses_read();
+		uint64_t start = os_gettime_ns();
+		if (bench_tick_callback)
+			bench_tick_callback(bench_tick_param, 1.0f / 60.0f);
+		for (int i = 0; i < bench_instances; i++)
+			shader_filter_tick(instances[i].filter, 1.0f / 60.0f);
+		uint64_t mid = os_gettime_ns();
+		uint64_t mid_misses = bench_misses_read();
+		size_t mid_allocs = bench_alloc_count;
+		size_t uploads = bench_uniform_uploads;
+		for (int i = 0; i < bench_instances; i++)
+			shader_filter_set_effect_params(instances[i].filter);
+		uint64_t end = os_gettime_ns();
+		uint64_t end_misses = bench_misses_read();
+		uploads = bench_uniform_uploads - uploads;
+
+		bench_stat_add(&tick, mid - start, bench_instances, mid_allocs - allocs, 0, mid_misses - misses);
+		bench_stat_add(&params, end - mid, bench_instances, bench_alloc_count - mid_allocs, uploads,
+			       end_misses - mid_misses);
+		bench_stat_add(&frame, end - start, bench_instances, bench_alloc_count - allocs, uploads,
+			       end_misses - misses);
+	}
+
+	for (int u = 0; u < bench_updates; u++) {
+		size_t allocs = bench_alloc_count;
+		uint64_t misses = bench_misses_read();
+		uint64_t start = os_gettime_ns();
+		for (int i = 0; i < bench_instances; i++)
+			shader_filter_update(instances[i].filter, instances[i].source.settings);
+		uint64_t end = os_gettime_ns();
+		bench_stat_add(&update, end - start, bench_instances, bench_alloc_count - allocs, 0,
+			       bench_misses_read() - misses);
+	}
+
+	printf("%d instances, %zu user params each, %d frames\n", bench_instances,
+	       instances[0].filter->stored_param_list.num, bench_frames);
+	printf("user param data walked per frame: %zu bytes per param, %zu bytes of schema left untouched\n",
+	       sizeof(struct effect_param_binding), sizeof(struct effect_param_data));
+	printf("%-34s %9s %9s %9s %9s %10s %10s %11s\n", "callback", "calls", "ns/op", "p50 ns", "p99 ns", "allocs/op",
+	       "uploads/op", "L1d miss/op");
+	double frame_allocs = (double)frame.allocs / (double)bench_frames;
+	double frame_uploads = (double)frame.uploads / (double)bench_frames;
+	double frame_us = (double)frame.total_ns / (double)bench_frames / 1000.0;
+	bench_stat_print(&tick);
+	bench_stat_print(&params);
+	bench_stat_print(&update);
+	bench_stat_print(&frame);
+	uint64_t skipped = 0;
+	for (int i = 0; i < bench_instances; i++)
+		skipped += instances[i].filter->uniform_uploads_skipped;
+	printf("per frame: %.1f us, %.1f uniform uploads, %.1f skipped at their default", frame_us, frame_uploads,
+	       (double)skipped / (double)bench_frames);
+	if (BENCH_COUNT_ALLOCS)
+		printf(", %.1f allocations", frame_allocs);
+	printf("\n");
+	bench_misses_close();
+
+	for (int i = 0; i < bench_instances; i++) {
+		shader_filter_destroy(instances[i].filter);
+		obs_data_release(instances[i].source.settings);
+	}
+	bfree(instances);
+	bfree(shader);
+	obs_data_release(bench_parent.settings);
+	obs_module_unload();
+
+	long leaked = bnum_allocs() - live_before;
+	if (leaked) {
+		fprintf(stderr, "%ld bmalloc blocks leaked\n", leaked);
+		return 1;
+	}
+	// Settings pushed at runtime, by obs-websocket for instance, must not touch the heap.
+	if (update.allocs) {
+		fprintf(stderr, "shader_filter_update allocated %zu times with unchanged settings\n", update.allocs);
+		return 1;
+	}
+	return 0;
+}
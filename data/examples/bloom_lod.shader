@@ -0,0 +1,67 @@
+// Bloom from the downsampled input levels, based on bloom.shader by Charles Fettinger
+// Takes 6 samples per pixel for a whole Radius, 11 between levels, instead of Angle_Steps * Radius_Steps
+#define NEED_INPUT_MIPS 5
+uniform texture2d image_mip1;
+uniform texture2d image_mip2;
+uniform texture2d image_mip3;
+uniform texture2d image_mip4;
+uniform texture2d image_mip5;
+
+uniform float Radius<
+    string label = "Radius (levels)";
+    string widget_type = "slider";
+    float minimum = 0.0;
+    float maximum = 5.0;
+    float step = 0.1;
+> = 3.0;
+uniform float ampFactor<
+    string label = "amp Factor";
+    string widget_type = "slider";
+    float minimum = 0.0;
+    float maximum = 10.0;
+    float step = 0.01;
+> = 2.0;
+uniform string notes<
+    string widget_type = "info";
+> = "Each radius level doubles the size of the bloom. Level n averages 2^n pixels in each direction.";
+
+float4 sampleLevel(float2 uv, float level)
+{
+	if (level < 1.0)
+		return image.Sample(textureSampler, uv);
+	if (level < 2.0)
+		return image_mip1.Sample(textureSampler, uv);
+	if (level < 3.0)
+		return image_mip2.Sample(textureSampler, uv);
+	if (level < 4.0)
+		return image_mip3.Sample(textureSampler, uv);
+	if (level < 5.0)
+		return image_mip4.Sample(textureSampler, uv);
+	return image_mip5.Sample(textureSampler, uv);
+}
+
+// Blends between the two nearest levels like SampleLevel does between mips.
+float4 sampleLod(float2 uv, float lod)
+{
+	float level = floor(lod);
+	if (lod == level)
+		return sampleLevel(uv, level);
+	return lerp(sampleLevel(uv, level), sampleLevel(uv, level + 1.0), lod - level);
+}
+
+float4 mainImage(VertData v_in) : TARGET
+{
+	float4 c0 = image.Sample(textureSampler, v_in.uv);
+	float4 accumulatedColor = float4(0,0,0,0);
+	float totalWeight = 0.0;
+
+	// Nearer levels weigh more, as the inner rings do in bloom.shader.
+	for (int level = 1; level <= 5; level++) {
+		float lod = min(float(level), Radius);
+		float weight = float(6 - level);
+		accumulatedColor += sampleLod(v_in.uv, lod) * weight;
+		totalWeight += weight;
+	}
+
+	return c0 + accumulatedColor / totalWeight * ampFactor;
+}
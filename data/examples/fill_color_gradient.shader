@@ -25,6 +25,7 @@ uniform float Gradient_Offset<
 uniform int Fill_Direction<
     string label = "Fill from:";
     string widget_type = "select";
+    bool specialize = true;
     int option_0_value = 0;
     string option_0_label = "Left";
     int option_1_value = 1;
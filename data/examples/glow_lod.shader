@@ -0,0 +1,96 @@
+// Glow from the downsampled input levels, based on glow.shader
+// The blur widens by sampling coarser levels instead of spreading the taps
+#define NEED_INPUT_MIPS 6
+uniform texture2d image_mip1;
+uniform texture2d image_mip2;
+uniform texture2d image_mip3;
+uniform texture2d image_mip4;
+uniform texture2d image_mip5;
+uniform texture2d image_mip6;
+
+uniform int glow_percent<
+    string label = "Glow percent";
+    string widget_type = "slider";
+    int minimum = 0;
+    int maximum = 100;
+    int step = 1;
+> = 10;
+uniform float blur<
+    string label = "Blur (levels)";
+    string widget_type = "slider";
+    float minimum = 0.0;
+    float maximum = 6.0;
+    float step = 0.1;
+> = 3.0;
+uniform int min_brightness<
+    string label = "Min brightness";
+    string widget_type = "slider";
+    int minimum = 0;
+    int maximum = 100;
+    int step = 1;
+> = 27;
+uniform int max_brightness<
+    string label = "Max brightness";
+    string widget_type = "slider";
+    int minimum = 0;
+    int maximum = 100;
+    int step = 1;
+> = 100;
+uniform int pulse_speed<
+    string label = "Pulse speed";
+    string widget_type = "slider";
+    int minimum = 0;
+    int maximum = 100;
+    int step = 1;
+> = 0;
+uniform string notes<
+    string widget_type = "info";
+> = "'glow_percent' - how much brightness to add (recommend 0-100). 'blur' - each level doubles how far the glow extends. 'pulse_speed' - (0-100). 'min/max brightness' - floor and ceiling brightness level to target for glows.";
+
+float4 sampleLevel(float2 uv, float level)
+{
+	if (level < 1.0)
+		return image.Sample(textureSampler, uv);
+	if (level < 2.0)
+		return image_mip1.Sample(textureSampler, uv);
+	if (level < 3.0)
+		return image_mip2.Sample(textureSampler, uv);
+	if (level < 4.0)
+		return image_mip3.Sample(textureSampler, uv);
+	if (level < 5.0)
+		return image_mip4.Sample(textureSampler, uv);
+	if (level < 6.0)
+		return image_mip5.Sample(textureSampler, uv);
+	return image_mip6.Sample(textureSampler, uv);
+}
+
+// Blends between the two nearest levels like SampleLevel does between mips.
+float4 sampleLod(float2 uv, float lod)
+{
+	float level = floor(lod);
+	if (lod == level)
+		return sampleLevel(uv, level);
+	return lerp(sampleLevel(uv, level), sampleLevel(uv, level + 1.0), lod - level);
+}
+
+float4 mainImage(VertData v_in) : TARGET
+{
+	float4 col = image.Sample(textureSampler, v_in.uv);
+	float glow_amount = float(glow_percent) * 0.01;
+	float speed = float(pulse_speed) * 0.01;
+	float luminance_floor = float(min_brightness) / 100.0;
+	float luminance_ceiling = float(max_brightness) / 100.0;
+
+	if (col.a > 0.0)
+	{
+		float b = 1.0 + sin(elapsed_time * speed);
+		float4 ncolor = sampleLod(v_in.uv, clamp(blur * b * 0.5, 0.0, 6.0));
+		float intensity = ncolor.r * 0.299 + ncolor.g * 0.587 + ncolor.b * 0.114;
+		if ((intensity >= luminance_floor) && (intensity <= luminance_ceiling))
+		{
+			ncolor.a = clamp(ncolor.a * glow_amount, 0.0, 1.0);
+			col += ncolor * (glow_amount * b) * 4.0;
+		}
+	}
+	return col;
+}
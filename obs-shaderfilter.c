@@ -17,16 +17,25 @@
 #include <string.h>
 #include <math.h>
 #include <stdint.h>
+#include <sys/stat.h>
 
 #include <util/threading.h>
+#include <util/task.h>
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <sys/time.h>
 #endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
 
 #include "version.h"
 #include "obs-shaderfilter.h"
+#include "shader-convert.h"
+#include "shader-preprocess.h"
 
 float (*move_get_transition_filter)(obs_source_t *filter_from, obs_source_t **filter_to) = NULL;
 
@@ -108,6 +117,13 @@ float4 mainImage(VertData v_in) : TARGET\n\
 ";
 
 static const char *effect_template_end = "\n\
+float4 mainImageLinear(VertData v_in) : TARGET\n\
+{\n\
+	float4 px = mainImage(v_in);\n\
+	px.rgb = srgb_nonlinear_to_linear(px.rgb);\n\
+	return px;\n\
+}\n\
+\n\
 technique Draw\n\
 {\n\
 	pass\n\
@@ -115,6 +131,15 @@ technique Draw\n\
 		vertex_shader = mainTransform(v_in);\n\
 		pixel_shader = mainImage(v_in);\n\
 	}\n\
+}\n\
+\n\
+technique DrawLinear\n\
+{\n\
+	pass\n\
+	{\n\
+		vertex_shader = mainTransform(v_in);\n\
+		pixel_shader = mainImageLinear(v_in);\n\
+	}\n\
 }\n";
 
 struct effect_param_data {
@@ -128,20 +153,13 @@ struct effect_param_data {
 	DARRAY(struct dstr) option_labels;
 
 	enum gs_shader_param_type type;
-	gs_eparam_t *param;
+	bool specialize;
 
 	gs_image_file_t *image;
-	gs_texrender_t *render;
+	struct param_source_texture *source_texture;
 	obs_weak_source_t *source;
+	bool source_rendered;
 
-	union {
-		long long i;
-		double f;
-		char *string;
-		struct vec2 vec2;
-		struct vec3 vec3;
-		struct vec4 vec4;
-	} value;
 	union {
 		long long i;
 		double f;
@@ -151,6 +169,11 @@ struct effect_param_data {
 		struct vec4 vec4;
 	} default_value;
 	bool has_default;
+	/* Made at reload so that shader_filter_update does not allocate. */
+	void *effect_default;
+	char *default_texture_path;
+	struct dstr component_keys[4];
+	struct dstr source_key;
 	char *label;
 	union {
 		long long i;
@@ -166,11 +189,128 @@ struct effect_param_data {
 	} step;
 };
 
-typedef DARRAY(char *) shader_path_array_t;
+/*
+ * The part of a user param that shader_filter_set_effect_params reads every
+ * frame. Kept in its own array, at the same index as the param's
+ * effect_param_data, so the per-frame walk stays within a few cache lines.
+ */
+struct effect_param_binding {
+	gs_eparam_t *param;
+	enum gs_shader_param_type type;
+	/* Cleared by shader_filter_update while the value equals the effect default. */
+	bool needs_upload;
+	union {
+		long long i;
+		double f;
+		char *string;
+		struct vec2 vec2;
+		struct vec3 vec3;
+		struct vec4 vec4;
+	} value;
+};
+
+#define SHADER_VARIANT_CACHE_SIZE 8
+
+/* Indices of a param and of the same named param of the filter move-transition moves towards. */
+struct param_interp_pair {
+	size_t from;
+	size_t to;
+};
+
+/* An effect compiled with the current values of specialized params as #defines. */
+struct shader_variant {
+	char *key;
+	gs_effect_t *effect;
+	uint64_t last_used;
+};
+
+/*
+ * "#define PASS<n>_TARGET name [scale] [format]" makes pass n of the Draw
+ * technique render into the intermediate texture name instead of the
+ * output. Later passes read it through "uniform texture2d name;". Passes
+ * without a target render the output.
+ */
+#define SHADER_MAX_PASSES 16
+
+/*
+ * "#define NEED_INPUT_MIPS n" downsamples the input n times, each level half
+ * the size of the one before, into "uniform texture2d image_mip1;" up to
+ * image_mip<n>. Sampling a level averages 2^level pixels in each direction.
+ */
+#define SHADER_MAX_INPUT_MIPS 8
+
+struct shader_pass_target {
+	char *name;
+	float scale;
+	enum gs_color_format format;
+	/* Leased from the texrender pool while the passes are drawn. */
+	gs_texrender_t *render;
+	gs_eparam_t *param;
+};
+
+typedef DARRAY(struct shader_pass_target) shader_pass_target_array_t;
+/* Per pass of the Draw technique, the index of its target plus one, 0 for the output. */
+typedef DARRAY(size_t) shader_pass_map_t;
+
+/* Uniforms the plugin sets itself. The ones uploaded by shader_filter_set_effect_params come first. */
+enum shader_builtin {
+	SHADER_BUILTIN_UV_OFFSET,
+	SHADER_BUILTIN_UV_SCALE,
+	SHADER_BUILTIN_UV_PIXEL_INTERVAL,
+	SHADER_BUILTIN_UV_SIZE,
+	SHADER_BUILTIN_CURRENT_TIME_MS,
+	SHADER_BUILTIN_CURRENT_TIME_SEC,
+	SHADER_BUILTIN_CURRENT_TIME_MIN,
+	SHADER_BUILTIN_CURRENT_TIME_HOUR,
+	SHADER_BUILTIN_CURRENT_TIME_DAY_OF_WEEK,
+	SHADER_BUILTIN_CURRENT_TIME_DAY_OF_MONTH,
+	SHADER_BUILTIN_CURRENT_TIME_MONTH,
+	SHADER_BUILTIN_CURRENT_TIME_DAY_OF_YEAR,
+	SHADER_BUILTIN_CURRENT_TIME_YEAR,
+	SHADER_BUILTIN_ELAPSED_TIME,
+	SHADER_BUILTIN_ELAPSED_TIME_START,
+	SHADER_BUILTIN_ELAPSED_TIME_SHOW,
+	SHADER_BUILTIN_ELAPSED_TIME_ACTIVE,
+	SHADER_BUILTIN_ELAPSED_TIME_ENABLE,
+	SHADER_BUILTIN_LOOPS,
+	SHADER_BUILTIN_LOOP_SECOND,
+	SHADER_BUILTIN_LOCAL_TIME,
+	SHADER_BUILTIN_RAND_F,
+	SHADER_BUILTIN_RAND_INSTANCE_F,
+	SHADER_BUILTIN_RAND_ACTIVATION_F,
+	SHADER_BUILTIN_AUDIO_PEAK,
+	SHADER_BUILTIN_AUDIO_MAGNITUDE,
+	SHADER_BUILTIN_NUM_UPLOADED,
+	SHADER_BUILTIN_IMAGE = SHADER_BUILTIN_NUM_UPLOADED,
+	SHADER_BUILTIN_PREVIOUS_IMAGE,
+	SHADER_BUILTIN_PREVIOUS_OUTPUT,
+	SHADER_BUILTIN_IMAGE_A,
+	SHADER_BUILTIN_IMAGE_B,
+	SHADER_BUILTIN_TRANSITION_TIME,
+	SHADER_BUILTIN_CONVERT_LINEAR,
+	SHADER_BUILTIN_VIEW_PROJ,
+	SHADER_BUILTIN_COUNT,
+};
+
+#define SHADER_BUILTIN_BIT(id) (1ULL << (id))
+#define SHADER_BUILTIN_AUDIO_MASK \
+	(SHADER_BUILTIN_BIT(SHADER_BUILTIN_AUDIO_PEAK) | SHADER_BUILTIN_BIT(SHADER_BUILTIN_AUDIO_MAGNITUDE))
+/* Builtins whose values change from frame to frame without any change to the settings. */
+#define SHADER_BUILTIN_TIME_MASK                                                                                           \
+	(((SHADER_BUILTIN_BIT(SHADER_BUILTIN_AUDIO_MAGNITUDE + 1) - SHADER_BUILTIN_BIT(SHADER_BUILTIN_CURRENT_TIME_MS)) & \
+	  ~(SHADER_BUILTIN_BIT(SHADER_BUILTIN_RAND_INSTANCE_F) | SHADER_BUILTIN_BIT(SHADER_BUILTIN_RAND_ACTIVATION_F))) | \
+	 SHADER_BUILTIN_BIT(SHADER_BUILTIN_PREVIOUS_IMAGE) | SHADER_BUILTIN_BIT(SHADER_BUILTIN_PREVIOUS_OUTPUT))
 
 struct shader_filter_data {
 	obs_source_t *context;
 	gs_effect_t *effect;
+	gs_effect_t *base_effect;
+	char *effect_text;
+	struct shader_variant variants[SHADER_VARIANT_CACHE_SIZE];
+	size_t num_variants;
+	uint64_t variant_clock;
+	struct dstr variant_key;
+	struct shader_compile_job *variant_job;
 	gs_effect_t *output_effect;
 	gs_vertbuffer_t *sprite_buffer;
 
@@ -178,9 +318,31 @@ struct shader_filter_data {
 	gs_texrender_t *previous_input_texrender;
 	gs_texrender_t *output_texrender;
 	gs_texrender_t *previous_output_texrender;
+	/* Set while input_texrender and output_texrender are leased from the pool for this frame. */
+	bool input_leased;
+	bool output_leased;
 	gs_eparam_t *param_output_image;
+	gs_eparam_t *param_output_texel;
+
+	shader_pass_target_array_t pass_targets;
+	shader_pass_map_t pass_map;
+
+	int input_mips;
+	gs_eparam_t *input_mip_params[SHADER_MAX_INPUT_MIPS];
+	/* Leased from the texrender pool while the shader is drawn. */
+	gs_texrender_t *input_mip_texrenders[SHADER_MAX_INPUT_MIPS];
+
+	/* Shaders run on the output of this one, each reading the previous result. */
+	DARRAY(struct shader_filter_data *) stages;
+	/* Ping-pong targets for the stages that do not sample previous_output, leased for this frame. */
+	gs_texrender_t *stage_texrenders[2];
+	/* Holds the result of the last stage, NULL if there are no stages. */
+	gs_texrender_t *stage_output;
+	/* Set on stages, which are not sources and keep their own settings. */
+	obs_data_t *stage_settings;
 
 	bool reload_effect;
+	struct shader_compile_job *compile_job;
 	struct dstr last_path;
 	bool last_from_file;
 	bool source;
@@ -189,6 +351,7 @@ struct shader_filter_data {
 	bool prev_transitioning;
 
 	bool use_pm_alpha;
+	bool use_linear_input;
 	bool output_rendered;
 	bool input_rendered;
 
@@ -199,39 +362,8 @@ struct shader_filter_data {
 	bool enabled;
 	bool use_template;
 
-	gs_eparam_t *param_uv_offset;
-	gs_eparam_t *param_uv_scale;
-	gs_eparam_t *param_uv_pixel_interval;
-	gs_eparam_t *param_uv_size;
-	gs_eparam_t *param_current_time_ms;
-	gs_eparam_t *param_current_time_sec;
-	gs_eparam_t *param_current_time_min;
-	gs_eparam_t *param_current_time_hour;
-	gs_eparam_t *param_current_time_day_of_week;
-	gs_eparam_t *param_current_time_day_of_month;
-	gs_eparam_t *param_current_time_month;
-	gs_eparam_t *param_current_time_day_of_year;
-	gs_eparam_t *param_current_time_year;
-	gs_eparam_t *param_elapsed_time;
-	gs_eparam_t *param_elapsed_time_start;
-	gs_eparam_t *param_elapsed_time_show;
-	gs_eparam_t *param_elapsed_time_active;
-	gs_eparam_t *param_elapsed_time_enable;
-	gs_eparam_t *param_loops;
-	gs_eparam_t *param_loop_second;
-	gs_eparam_t *param_local_time;
-	gs_eparam_t *param_rand_f;
-	gs_eparam_t *param_rand_instance_f;
-	gs_eparam_t *param_rand_activation_f;
-	gs_eparam_t *param_image;
-	gs_eparam_t *param_previous_image;
-	gs_eparam_t *param_image_a;
-	gs_eparam_t *param_image_b;
-	gs_eparam_t *param_transition_time;
-	gs_eparam_t *param_convert_linear;
-	gs_eparam_t *param_previous_output;
-	gs_eparam_t *param_audio_peak;
-	gs_eparam_t *param_audio_magnitude;
+	gs_eparam_t *builtin_params[SHADER_BUILTIN_COUNT];
+	uint64_t used_builtins;
 
 	int expand_left;
 	int expand_right;
@@ -240,6 +372,11 @@ struct shader_filter_data {
 
 	int total_width;
 	int total_height;
+	/* The shader is drawn at render_scale of the total size and upscaled by draw_output. */
+	float render_scale;
+	bool render_sharpen;
+	int render_width;
+	int render_height;
 	int width;
 	int height;
 	bool no_repeat;
@@ -249,7 +386,32 @@ struct shader_filter_data {
 	uint64_t auto_reload_deadline;
 	bool auto_triggered_reload;
 
+	shader_path_array_t dependencies;
+	volatile bool dependency_changed;
+
+	uint64_t uniform_uploads;
+	uint64_t uniform_uploads_skipped;
+
+	/* Draw the shader every update_interval frames or update_rate times a second and output_texrender in between. */
+	int update_interval;
+	float update_rate;
+	uint32_t update_phase;
+	float update_elapsed;
+	bool update_due;
+	bool update_forced;
+	/* Set when output_texrender is kept between frames, for decimation or unchanged content. */
+	bool hold_output;
+	/* The shader draws the same result for the same input and uniforms, and the input reports its changes. */
+	bool content_static;
+	/* Changes whenever the target shows something else, see shader_filter_input_signature. */
+	uint64_t input_signature;
+	/* Hash of the input and uniforms output_texrender was drawn with, 0 if it was not drawn from static content. */
+	uint64_t content_hash;
+
 	float last_render_f;
+	/* How often the filter was drawn in this and the previous frame, a second draw reuses output_texrender. */
+	int renders;
+	int previous_renders;
 
 	struct vec2 uv_offset;
 	struct vec2 uv_scale;
@@ -260,6 +422,7 @@ struct shader_filter_data {
 	int loops;
 	float local_time;
 	float rand_f;
+	uint64_t rand_state;
 	float rand_instance_f;
 	float rand_activation_f;
 	float audio_peak;
@@ -272,161 +435,615 @@ struct shader_filter_data {
 	pthread_mutex_t audio_mutex;
 
 	DARRAY(struct effect_param_data) stored_param_list;
+	DARRAY(struct effect_param_binding) param_bindings;
+	/* Changes whenever stored_param_list is rebuilt, unique across instances. */
+	long param_generation;
+
+	struct shader_filter_data *interp_target;
+	long interp_generation;
+	long interp_target_generation;
+	DARRAY(struct param_interp_pair) interp_pairs;
 };
 
-static unsigned int rand_interval(unsigned int min, unsigned int max)
+static volatile long shader_param_generation = 0;
+
+static obs_data_t *shader_filter_get_settings(struct shader_filter_data *filter)
 {
-	const unsigned int range = 1 + max - min;
-	uint64_t x = os_gettime_ns() ^ (uint64_t)(uintptr_t)&x;
+	if (filter->stage_settings) {
+		obs_data_addref(filter->stage_settings);
+		return filter->stage_settings;
+	}
+	return obs_source_get_settings(filter->context);
+}
+
+static uint64_t rand_next(uint64_t *state)
+{
+	uint64_t x = *state;
 	x ^= x >> 12;
 	x ^= x << 25;
 	x ^= x >> 27;
-	x *= 2685821657736338717ULL;
+	*state = x;
+	return x * 2685821657736338717ULL;
+}
+
+static unsigned int rand_interval(unsigned int min, unsigned int max)
+{
+	const unsigned int range = 1 + max - min;
+	uint64_t x = os_gettime_ns() ^ (uint64_t)(uintptr_t)&x;
+	return min + (unsigned int)(rand_next(&x) % range);
+}
+
+/*
+ * Time shared by every instance. shader_frame_clock_tick runs once per video
+ * frame, before the sources tick, so all filters of a frame see the same
+ * values and the clock syscalls happen once instead of once per instance.
+ */
+struct frame_clock {
+	uint64_t frame;
+	uint64_t now_ns;
+	float local_time;
+	int wall_ms;
+	time_t wall_sec;
+	struct tm local;
+};
+
+static struct frame_clock shader_clock;
+
+static void shader_frame_clock_tick(void *param, float seconds)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(seconds);
+
+	shader_clock.frame++;
+	shader_clock.now_ns = os_gettime_ns();
+	shader_clock.local_time = (float)(shader_clock.now_ns / 1000000000.0);
+#ifdef _WIN32
+	SYSTEMTIME system_time;
+	GetSystemTime(&system_time);
+	shader_clock.wall_ms = system_time.wMilliseconds;
+	time_t wall_sec = time(NULL);
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	shader_clock.wall_ms = (int)(tv.tv_usec / 1000);
+	time_t wall_sec = tv.tv_sec;
+#endif
+	// The local time fields only change once a second.
+	if (wall_sec != shader_clock.wall_sec) {
+		struct tm *local = localtime(&wall_sec);
+		if (local) {
+			shader_clock.local = *local;
+			shader_clock.wall_sec = wall_sec;
+		}
+	}
+}
+
+/*
+ * Module-wide registry of compiled effects. Instances whose final effect
+ * text is identical share one gs_effect_t; each instance still owns its
+ * uniform values and applies them right before drawing with the effect.
+ */
+struct shared_effect {
+	uint64_t hash;
+	char *text;
+	gs_effect_t *effect;
+	long refs;
+};
+
+static DARRAY(struct shared_effect) shared_effects;
+static pthread_mutex_t shared_effects_mutex;
 
-	return min + (unsigned int)(x % range);
+static uint64_t hash_effect_text(const char *text)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (const unsigned char *ch = (const unsigned char *)text; *ch; ch++) {
+		hash ^= *ch;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
 }
 
-static char *load_shader_from_file_internal(const char *file_name, shader_path_array_t *visited)
+/* Must be called inside the graphics context. */
+static gs_effect_t *shared_effect_acquire(const char *effect_text, char **errors)
 {
-	for (size_t i = 0; i < visited->num; i++) {
-		if (strcmp(visited->array[i], file_name) == 0) {
-			blog(LOG_WARNING,
-			     "[obs-shaderfilter] circular include detected: %s",
-			     file_name);
-			return bstrdup("");
+	uint64_t hash = hash_effect_text(effect_text);
+	gs_effect_t *effect = NULL;
+
+	pthread_mutex_lock(&shared_effects_mutex);
+	for (size_t i = 0; i < shared_effects.num; i++) {
+		struct shared_effect *entry = shared_effects.array + i;
+		if (entry->hash == hash && strcmp(entry->text, effect_text) == 0) {
+			entry->refs++;
+			effect = entry->effect;
+			break;
+		}
+	}
+	if (!effect) {
+		effect = gs_effect_create(effect_text, NULL, errors);
+		if (effect) {
+			struct shared_effect *entry = da_push_back_new(shared_effects);
+			entry->hash = hash;
+			entry->text = bstrdup(effect_text);
+			entry->effect = effect;
+			entry->refs = 1;
+		}
+	}
+	pthread_mutex_unlock(&shared_effects_mutex);
+	return effect;
+}
+
+/* Must be called inside the graphics context. */
+static void shared_effect_release(gs_effect_t *effect)
+{
+	if (!effect)
+		return;
+
+	pthread_mutex_lock(&shared_effects_mutex);
+	for (size_t i = 0; i < shared_effects.num; i++) {
+		struct shared_effect *entry = shared_effects.array + i;
+		if (entry->effect != effect)
+			continue;
+		if (--entry->refs == 0) {
+			gs_effect_destroy(entry->effect);
+			bfree(entry->text);
+			da_erase(shared_effects, i);
 		}
+		break;
 	}
-	char *dup = bstrdup(file_name);
-	darray_push_back(sizeof(char *), &visited->da, &dup);
+	pthread_mutex_unlock(&shared_effects_mutex);
+}
+
+/*
+ * Module-wide pool of texrenders keyed by size and format. Texrenders that
+ * are only read within the frame they are drawn in are leased from it
+ * instead of being owned by an instance, so instances of the same size
+ * share them and a resized source does not reallocate each one. A lease
+ * ends with texrender_pool_release or at the next frame. Filters release
+ * theirs once they are drawn, so the next filter in the same frame can use
+ * them. Only used from the graphics thread.
+ */
+#define TEXRENDER_POOL_MAX_IDLE_FRAMES 120
 
-	struct dstr shader_file;
-	dstr_init(&shader_file);
+struct texrender_pool_entry {
+	gs_texrender_t *render;
+	uint32_t cx;
+	uint32_t cy;
+	enum gs_color_format format;
+	/* Frame the entry is leased for, 0 once it was released. */
+	uint64_t lease_frame;
+	uint64_t last_used;
+};
 
-	char *file_ptr = os_quick_read_utf8_file(file_name);
-	if (file_ptr == NULL) {
-		blog(LOG_WARNING, "[obs-shaderfilter] failed to read file: %s",
-		     file_name);
-		dstr_free(&shader_file);
-		return NULL;
+static DARRAY(struct texrender_pool_entry) texrender_pool;
+static struct {
+	uint64_t created;
+	uint64_t reused;
+	uint64_t destroyed;
+	size_t bytes;
+	size_t peak_bytes;
+} texrender_pool_stats;
+
+static size_t texrender_pool_entry_bytes(const struct texrender_pool_entry *entry)
+{
+	size_t pixel_size;
+	switch (entry->format) {
+	case GS_R8:
+		pixel_size = 1;
+		break;
+	case GS_R16F:
+		pixel_size = 2;
+		break;
+	case GS_RGBA16F:
+	case GS_RG32F:
+		pixel_size = 8;
+		break;
+	case GS_RGBA32F:
+		pixel_size = 16;
+		break;
+	default:
+		pixel_size = 4;
+	}
+	return (size_t)entry->cx * entry->cy * pixel_size;
+}
+
+/* Must be called inside the graphics context. */
+static gs_texrender_t *texrender_pool_lease(uint32_t cx, uint32_t cy, enum gs_color_format format)
+{
+	const uint64_t frame = shader_clock.frame;
+	struct texrender_pool_entry *found = NULL;
+	for (size_t i = texrender_pool.num; i > 0; i--) {
+		struct texrender_pool_entry *entry = texrender_pool.array + i - 1;
+		if (entry->lease_frame == frame)
+			continue;
+		if (!found && entry->cx == cx && entry->cy == cy && entry->format == format) {
+			found = entry;
+		} else if (frame - entry->last_used > TEXRENDER_POOL_MAX_IDLE_FRAMES) {
+			texrender_pool_stats.bytes -= texrender_pool_entry_bytes(entry);
+			texrender_pool_stats.destroyed++;
+			gs_texrender_destroy(entry->render);
+			da_erase(texrender_pool, i - 1);
+			// The match was found further back and moved down.
+			if (found)
+				found--;
+		}
+	}
+
+	if (found) {
+		texrender_pool_stats.reused++;
+		gs_texrender_reset(found->render);
+	} else {
+		found = da_push_back_new(texrender_pool);
+		found->render = gs_texrender_create(format, GS_ZS_NONE);
+		found->cx = cx;
+		found->cy = cy;
+		found->format = format;
+		texrender_pool_stats.created++;
+		texrender_pool_stats.bytes += texrender_pool_entry_bytes(found);
+		if (texrender_pool_stats.bytes > texrender_pool_stats.peak_bytes)
+			texrender_pool_stats.peak_bytes = texrender_pool_stats.bytes;
+	}
+	found->lease_frame = frame;
+	found->last_used = frame;
+	return found->render;
+}
+
+/* Hands render back before the frame ends, so the next lease of its size can use it. */
+static void texrender_pool_release(gs_texrender_t *render)
+{
+	for (size_t i = 0; i < texrender_pool.num; i++) {
+		if (texrender_pool.array[i].render == render) {
+			texrender_pool.array[i].lease_frame = 0;
+			break;
+		}
+	}
+}
+
+/* "shaderfilter_texrender_pool_stats" on the libobs proc handler, for checking the pool while OBS runs. */
+static void texrender_pool_get_stats(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	// The pool changes under the graphics context only.
+	obs_enter_graphics();
+	calldata_set_int(cd, "entries", (long long)texrender_pool.num);
+	calldata_set_int(cd, "created", (long long)texrender_pool_stats.created);
+	calldata_set_int(cd, "reused", (long long)texrender_pool_stats.reused);
+	calldata_set_int(cd, "destroyed", (long long)texrender_pool_stats.destroyed);
+	calldata_set_int(cd, "bytes", (long long)texrender_pool_stats.bytes);
+	calldata_set_int(cd, "peak_bytes", (long long)texrender_pool_stats.peak_bytes);
+	obs_leave_graphics();
+}
+
+static void texrender_pool_free(void)
+{
+	if (texrender_pool_stats.created)
+		blog(LOG_INFO,
+		     "[obs-shaderfilter] texrender pool: %llu created, %llu reused, %llu freed early, peak %.1f MiB",
+		     (unsigned long long)texrender_pool_stats.created, (unsigned long long)texrender_pool_stats.reused,
+		     (unsigned long long)texrender_pool_stats.destroyed,
+		     (double)texrender_pool_stats.peak_bytes / (1024.0 * 1024.0));
+	if (texrender_pool.num) {
+		obs_enter_graphics();
+		for (size_t i = 0; i < texrender_pool.num; i++)
+			gs_texrender_destroy(texrender_pool.array[i].render);
+		obs_leave_graphics();
+	}
+	da_free(texrender_pool);
+}
+
+/*
+ * Sources picked for texture params, drawn at most once per frame and shared
+ * by every param that shows the same source at the same size and color space.
+ * Only used with the graphics context entered.
+ */
+struct param_source_texture {
+	/* Compared only, the params hold the references. */
+	obs_source_t *source;
+	uint32_t cx;
+	uint32_t cy;
+	enum gs_color_space space;
+	gs_texrender_t *render;
+	uint64_t rendered_frame;
+	long refs;
+};
+
+static DARRAY(struct param_source_texture *) param_source_textures;
+
+static struct {
+	uint64_t renders;
+	uint64_t shared;
+} param_source_texture_stats;
+
+static struct param_source_texture *param_source_texture_acquire(obs_source_t *source, uint32_t cx, uint32_t cy,
+								 enum gs_color_space space)
+{
+	for (size_t i = 0; i < param_source_textures.num; i++) {
+		struct param_source_texture *texture = param_source_textures.array[i];
+		if (texture->source == source && texture->cx == cx && texture->cy == cy && texture->space == space) {
+			texture->refs++;
+			return texture;
+		}
+	}
+
+	struct param_source_texture *texture = bzalloc(sizeof(struct param_source_texture));
+	texture->source = source;
+	texture->cx = cx;
+	texture->cy = cy;
+	texture->space = space;
+	texture->render = gs_texrender_create(gs_get_format_from_space(space), GS_ZS_NONE);
+	texture->refs = 1;
+	da_push_back(param_source_textures, &texture);
+	return texture;
+}
+
+static void param_source_texture_release(struct param_source_texture *texture)
+{
+	if (!texture || --texture->refs > 0)
+		return;
+	da_erase_item(param_source_textures, &texture);
+	gs_texrender_destroy(texture->render);
+	bfree(texture);
+}
+
+/* Draws source into texture unless another param already did in this frame. */
+static void param_source_texture_render(struct param_source_texture *texture, obs_source_t *source)
+{
+	if (texture->rendered_frame == shader_clock.frame) {
+		param_source_texture_stats.shared++;
+		return;
+	}
+	// Set first, a source that shows a filter reading it back must not recurse.
+	texture->rendered_frame = shader_clock.frame;
+	param_source_texture_stats.renders++;
+
+	gs_texrender_reset(texture->render);
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	if (gs_texrender_begin_with_color_space(texture->render, texture->cx, texture->cy, texture->space)) {
+		const float w = (float)texture->cx;
+		const float h = (float)texture->cy;
+		uint32_t flags = obs_source_get_output_flags(source);
+		const bool custom_draw = (flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
+		const bool async = (flags & OBS_SOURCE_ASYNC) != 0;
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, w, 0.0f, h, -100.0f, 100.0f);
+
+		if (!custom_draw && !async)
+			obs_source_default_render(source);
+		else
+			obs_source_video_render(source);
+		gs_texrender_end(texture->render);
+	}
+	gs_blend_state_pop();
+}
+
+static void param_source_texture_free(void)
+{
+	if (param_source_texture_stats.renders)
+		blog(LOG_INFO, "[obs-shaderfilter] source textures: %llu renders, %llu shared",
+		     (unsigned long long)param_source_texture_stats.renders, (unsigned long long)param_source_texture_stats.shared);
+	da_free(param_source_textures);
+}
+
+/*
+ * Module-wide shader file watcher. Every instance loaded from a file
+ * registers the file and everything it includes; when one of them changes
+ * on disk only the instances that depend on it get a debounced reload.
+ * Directories are watched instead of files so editors that save by
+ * renaming a temporary file over the original are still noticed.
+ */
+#ifdef __linux__
+struct watched_dir {
+	int wd;
+	char *path;
+	long refs;
+};
+
+static int shader_watch_fd = -1;
+static pthread_t shader_watch_thread;
+static volatile bool shader_watch_stop;
+static pthread_mutex_t shader_watch_mutex;
+static DARRAY(struct watched_dir) shader_watch_dirs;
+static DARRAY(struct shader_filter_data *) shader_watchers;
+
+static void shader_watch_dir_ref(const char *file)
+{
+	const char *slash = strrchr(file, '/');
+	if (!slash)
+		return;
+
+	struct dstr dir = {0};
+	dstr_ncopy(&dir, file, slash == file ? 1 : slash - file);
+	for (size_t i = 0; i < shader_watch_dirs.num; i++) {
+		if (strcmp(shader_watch_dirs.array[i].path, dir.array) == 0) {
+			shader_watch_dirs.array[i].refs++;
+			dstr_free(&dir);
+			return;
+		}
+	}
+
+	int wd = inotify_add_watch(shader_watch_fd, dir.array, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (wd < 0) {
+		blog(LOG_WARNING, "[obs-shaderfilter] unable to watch '%s' for changes", dir.array);
+		dstr_free(&dir);
+		return;
+	}
+	struct watched_dir *entry = da_push_back_new(shader_watch_dirs);
+	entry->wd = wd;
+	entry->path = dir.array;
+	entry->refs = 1;
+}
+
+static void shader_watch_dir_unref(const char *file)
+{
+	const char *slash = strrchr(file, '/');
+	if (!slash)
+		return;
+
+	size_t len = slash == file ? 1 : slash - file;
+	for (size_t i = 0; i < shader_watch_dirs.num; i++) {
+		struct watched_dir *entry = shader_watch_dirs.array + i;
+		if (strlen(entry->path) != len || strncmp(entry->path, file, len) != 0)
+			continue;
+		if (--entry->refs == 0) {
+			inotify_rm_watch(shader_watch_fd, entry->wd);
+			bfree(entry->path);
+			da_erase(shader_watch_dirs, i);
+		}
+		return;
 	}
-	char **lines = strlist_split(file_ptr, '\n', true);
-
-	size_t line_i = 0;
-	while (lines[line_i] != NULL) {
-		char *line = lines[line_i];
-		line_i++;
-		if (strncmp(line, "#include", 8) == 0) {
-			struct dstr include_path = {0};
-			char *pos = strrchr(file_name, '/');
-			if (!pos)
-				pos = strrchr(file_name, '\\');
-			if (pos) {
-				size_t length = pos - file_name + 1;
-				dstr_ncopy(&include_path, file_name, length);
+}
+
+static void shader_watch_file_changed(const char *path)
+{
+	for (size_t i = 0; i < shader_watchers.num; i++) {
+		struct shader_filter_data *filter = shader_watchers.array[i];
+		for (size_t j = 0; j < filter->dependencies.num; j++) {
+			if (strcmp(filter->dependencies.array[j], path) == 0) {
+				os_atomic_store_bool(&filter->dependency_changed, true);
+				break;
 			}
-			char *q1 = strchr(line, '"');
-			char *q2 = q1 ? strrchr(line, '"') : NULL;
-			if (!q1 || !q2 || q2 <= q1) {
-				blog(LOG_WARNING,
-				     "[obs-shaderfilter] malformed #include line: %s",
-				     line);
-				dstr_free(&include_path);
+		}
+	}
+}
+
+static void *shader_watch_thread_func(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	os_set_thread_name("shaderfilter: file watcher");
+
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct dstr path = {0};
+	struct pollfd fds = {.fd = shader_watch_fd, .events = POLLIN};
+
+	while (!os_atomic_load_bool(&shader_watch_stop)) {
+		if (poll(&fds, 1, 250) <= 0)
+			continue;
+
+		ssize_t len = read(shader_watch_fd, buffer, sizeof(buffer));
+		if (len <= 0)
+			continue;
+
+		pthread_mutex_lock(&shader_watch_mutex);
+		for (char *ptr = buffer; ptr < buffer + len;) {
+			const struct inotify_event *event = (const struct inotify_event *)ptr;
+			ptr += sizeof(struct inotify_event) + event->len;
+			if (!event->len)
 				continue;
+			for (size_t i = 0; i < shader_watch_dirs.num; i++) {
+				if (shader_watch_dirs.array[i].wd != event->wd)
+					continue;
+				dstr_copy(&path, shader_watch_dirs.array[i].path);
+				if (path.len && path.array[path.len - 1] != '/')
+					dstr_cat_ch(&path, '/');
+				dstr_cat(&path, event->name);
+				shader_watch_file_changed(path.array);
+				break;
 			}
-			char *start = q1 + 1;
-			char *end = q2;
-
-			dstr_ncat(&include_path, start, end - start);
-			char *abs_include_path =
-				os_get_abs_path_ptr(include_path.array);
-			char *file_contents = abs_include_path ? load_shader_from_file_internal(
-				abs_include_path, visited) : NULL;
-			if (file_contents) {
-				dstr_cat(&shader_file, file_contents);
-				dstr_cat(&shader_file, "\n");
-				bfree(file_contents);
-			} else {
-				blog(LOG_ERROR,
-				     "[obs-shaderfilter] failed to resolve #include '%s' from '%s'",
-				     include_path.array, file_name);
-				dstr_cat(&shader_file, "\n// ERROR: failed to resolve #include: ");
-				dstr_cat(&shader_file, include_path.array);
-				dstr_cat(&shader_file, "\n");
-			}
-			bfree(abs_include_path);
-			dstr_free(&include_path);
-		} else {
-			// else place current line here.
-			dstr_cat(&shader_file, line);
-			dstr_cat(&shader_file, "\n");
 		}
+		pthread_mutex_unlock(&shader_watch_mutex);
 	}
 
-	bfree(file_ptr);
-	strlist_free(lines);
+	dstr_free(&path);
+	return NULL;
+}
+
+static void shader_watch_init(void)
+{
+	pthread_mutex_init(&shader_watch_mutex, NULL);
+	da_init(shader_watch_dirs);
+	da_init(shader_watchers);
+
+	shader_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (shader_watch_fd < 0) {
+		blog(LOG_WARNING, "[obs-shaderfilter] inotify unavailable, shader files will not reload automatically");
+		return;
+	}
+	shader_watch_stop = false;
+	if (pthread_create(&shader_watch_thread, NULL, shader_watch_thread_func, NULL) != 0) {
+		close(shader_watch_fd);
+		shader_watch_fd = -1;
+	}
+}
 
-	/* Transfer ownership: null out dstr's array so dstr_free is a no-op
-	 * on the buffer; caller owns and must bfree() the returned pointer. */
-	char *result = shader_file.array;
-	shader_file.array = NULL;
-	dstr_free(&shader_file);
-	return result;
+static void shader_watch_free(void)
+{
+	if (shader_watch_fd >= 0) {
+		os_atomic_store_bool(&shader_watch_stop, true);
+		pthread_join(shader_watch_thread, NULL);
+		close(shader_watch_fd);
+		shader_watch_fd = -1;
+	}
+	for (size_t i = 0; i < shader_watch_dirs.num; i++)
+		bfree(shader_watch_dirs.array[i].path);
+	da_free(shader_watch_dirs);
+	da_free(shader_watchers);
+	pthread_mutex_destroy(&shader_watch_mutex);
 }
 
-/**
- * Returns a heap-allocated string (owned by caller, free with bfree()).
- * Returns NULL on failure.
- */
-static char *load_shader_from_file(const char *file_name)
+/* Takes ownership of the paths in dependencies. */
+static void shader_watch_set_dependencies(struct shader_filter_data *filter, shader_path_array_t *dependencies)
+{
+	pthread_mutex_lock(&shader_watch_mutex);
+	if (shader_watch_fd >= 0) {
+		for (size_t i = 0; i < filter->dependencies.num; i++)
+			shader_watch_dir_unref(filter->dependencies.array[i]);
+	}
+	free_shader_paths(&filter->dependencies);
+
+	for (size_t i = 0; i < dependencies->num; i++) {
+		char *abs_path = os_get_abs_path_ptr(dependencies->array[i]);
+		if (abs_path) {
+			bfree(dependencies->array[i]);
+			dependencies->array[i] = abs_path;
+		}
+	}
+	filter->dependencies = *dependencies;
+	da_init(*dependencies);
+
+	if (shader_watch_fd >= 0) {
+		for (size_t i = 0; i < filter->dependencies.num; i++)
+			shader_watch_dir_ref(filter->dependencies.array[i]);
+	}
+
+	size_t idx = DARRAY_INVALID;
+	for (size_t i = 0; i < shader_watchers.num; i++) {
+		if (shader_watchers.array[i] == filter) {
+			idx = i;
+			break;
+		}
+	}
+	if (filter->dependencies.num && idx == DARRAY_INVALID)
+		da_push_back(shader_watchers, &filter);
+	else if (!filter->dependencies.num && idx != DARRAY_INVALID)
+		da_erase(shader_watchers, idx);
+	pthread_mutex_unlock(&shader_watch_mutex);
+}
+#else
+static void shader_watch_init(void) {}
+
+static void shader_watch_free(void) {}
+
+static void shader_watch_set_dependencies(struct shader_filter_data *filter, shader_path_array_t *dependencies)
 {
-	shader_path_array_t visited;
-	da_init(visited);
-	char *result = load_shader_from_file_internal(file_name, &visited);
-	for (size_t i = 0; i < visited.num; i++)
-		bfree(visited.array[i]);
-	da_free(visited);
-	return result;
+	UNUSED_PARAMETER(filter);
+	free_shader_paths(dependencies);
 }
+#endif
 
 static void shader_filter_clear_params(struct shader_filter_data *filter)
 {
-	filter->param_current_time_ms = NULL;
-	filter->param_current_time_sec = NULL;
-	filter->param_current_time_min = NULL;
-	filter->param_current_time_hour = NULL;
-	filter->param_current_time_day_of_week = NULL;
-	filter->param_current_time_day_of_month = NULL;
-	filter->param_current_time_month = NULL;
-	filter->param_current_time_day_of_year = NULL;
-	filter->param_current_time_year = NULL;
-	filter->param_elapsed_time = NULL;
-	filter->param_elapsed_time_start = NULL;
-	filter->param_elapsed_time_show = NULL;
-	filter->param_elapsed_time_active = NULL;
-	filter->param_elapsed_time_enable = NULL;
-	filter->param_uv_offset = NULL;
-	filter->param_uv_pixel_interval = NULL;
-	filter->param_uv_scale = NULL;
-	filter->param_uv_size = NULL;
-	filter->param_rand_f = NULL;
-	filter->param_rand_activation_f = NULL;
-	filter->param_rand_instance_f = NULL;
-	filter->param_loops = NULL;
-	filter->param_loop_second = NULL;
-	filter->param_local_time = NULL;
-	filter->param_audio_peak = NULL;
-	filter->param_audio_magnitude = NULL;
-	filter->param_image = NULL;
-	filter->param_previous_image = NULL;
-	filter->param_image_a = NULL;
-	filter->param_image_b = NULL;
-	filter->param_transition_time = NULL;
-	filter->param_convert_linear = NULL;
-	filter->param_previous_output = NULL;
+	memset(filter->builtin_params, 0, sizeof(filter->builtin_params));
+	memset(filter->input_mip_params, 0, sizeof(filter->input_mip_params));
+	filter->used_builtins = 0;
+	filter->param_generation = os_atomic_inc_long(&shader_param_generation);
 
 	size_t param_count = filter->stored_param_list.num;
 	for (size_t param_index = 0; param_index < param_count; param_index++) {
 		struct effect_param_data *param = (filter->stored_param_list.array + param_index);
+		struct effect_param_binding *binding = (filter->param_bindings.array + param_index);
 		if (param->image) {
 			obs_enter_graphics();
 			gs_image_file_free(param->image);
@@ -447,18 +1064,23 @@ static void shader_filter_clear_params(struct shader_filter_data *filter)
 			obs_weak_source_release(param->source);
 			param->source = NULL;
 		}
-		if (param->render) {
+		if (param->source_texture) {
 			obs_enter_graphics();
-			gs_texrender_destroy(param->render);
+			param_source_texture_release(param->source_texture);
 			obs_leave_graphics();
-			param->render = NULL;
+			param->source_texture = NULL;
 		}
 		if (param->type == GS_SHADER_PARAM_STRING) {
-			bfree(param->value.string);
-			param->value.string = NULL;
+			bfree(binding->value.string);
+			binding->value.string = NULL;
 			bfree(param->default_value.string);
 			param->default_value.string = NULL;
 		}
+		bfree(param->effect_default);
+		bfree(param->default_texture_path);
+		for (size_t i = 0; i < OBS_COUNTOF(param->component_keys); i++)
+			dstr_free(&param->component_keys[i]);
+		dstr_free(&param->source_key);
 		dstr_free(&param->name);
 		dstr_free(&param->display_name);
 		dstr_free(&param->widget_type);
@@ -473,13 +1095,37 @@ static void shader_filter_clear_params(struct shader_filter_data *filter)
 	}
 
 	da_free(filter->stored_param_list);
+	da_free(filter->param_bindings);
+}
+
+/*
+ * Params annotated with "bool specialize = true" are compiled into the
+ * effect as #defines, so the GPU does not branch on them per pixel. Each
+ * instance keeps the most recently used permutations compiled.
+ */
+static void shader_compile_job_release(struct shader_compile_job *job);
+
+static void shader_filter_clear_variants(struct shader_filter_data *filter)
+{
+	// A permutation still being built belongs to the text it was queued with.
+	shader_compile_job_release(filter->variant_job);
+	filter->variant_job = NULL;
+	if (!filter->num_variants)
+		return;
+	obs_enter_graphics();
+	for (size_t i = 0; i < filter->num_variants; i++)
+		shared_effect_release(filter->variants[i].effect);
+	obs_leave_graphics();
+	for (size_t i = 0; i < filter->num_variants; i++)
+		bfree(filter->variants[i].key);
+	filter->num_variants = 0;
 }
 
 static void load_output_effect(struct shader_filter_data *filter)
 {
 	if (filter->output_effect != NULL) {
 		obs_enter_graphics();
-		gs_effect_destroy(filter->output_effect);
+		shared_effect_release(filter->output_effect);
 		filter->output_effect = NULL;
 		obs_leave_graphics();
 	}
@@ -490,17 +1136,17 @@ static void load_output_effect(struct shader_filter_data *filter)
 	dstr_cat(&filename, "/internal/render_output.effect");
 	char *abs_path = os_get_abs_path_ptr(filename.array);
 	if (abs_path) {
-		shader_text = load_shader_from_file(abs_path);
+		shader_text = load_shader_from_file(abs_path, NULL);
 		bfree(abs_path);
 	}
 	if (!shader_text)
-		shader_text = load_shader_from_file(filename.array);
+		shader_text = load_shader_from_file(filename.array, NULL);
 
 	char *errors = NULL;
 	dstr_free(&filename);
 
 	obs_enter_graphics();
-	filter->output_effect = gs_effect_create(shader_text, NULL, &errors);
+	filter->output_effect = shader_text ? shared_effect_acquire(shader_text, &errors) : NULL;
 	obs_leave_graphics();
 
 	bfree(shader_text);
@@ -516,6 +1162,8 @@ static void load_output_effect(struct shader_filter_data *filter)
 			gs_effect_get_param_info(param, &info);
 			if (strcmp(info.name, "output_image") == 0) {
 				filter->param_output_image = param;
+			} else if (strcmp(info.name, "output_texel") == 0) {
+				filter->param_output_texel = param;
 			}
 		}
 	}
@@ -537,45 +1185,780 @@ static void load_sprite_buffer(struct shader_filter_data *filter)
 	filter->sprite_buffer = gs_vertexbuffer_create(vbd, GS_DYNAMIC);
 }
 
-static void shader_filter_reload_effect(struct shader_filter_data *filter)
+static bool is_var_char(char ch)
 {
-	obs_data_t *settings = obs_source_get_settings(filter->context);
+	return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+}
 
-	// First, clean up the old effect and all references to it.
-	filter->shader_start_time = 0.0f;
-	shader_filter_clear_params(filter);
+static inline int lowest_set_bit(uint64_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
 
-	if (filter->effect != NULL) {
-		obs_enter_graphics();
-		gs_effect_destroy(filter->effect);
-		filter->effect = NULL;
-		obs_leave_graphics();
+typedef void (*shader_builtin_upload_t)(const struct shader_filter_data *filter, gs_eparam_t *param,
+					const struct frame_clock *clock);
+
+static void upload_uv_offset(const struct shader_filter_data *filter, gs_eparam_t *param, const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_vec2(param, &filter->uv_offset);
+}
+
+static void upload_uv_scale(const struct shader_filter_data *filter, gs_eparam_t *param, const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_vec2(param, &filter->uv_scale);
+}
+
+static void upload_uv_pixel_interval(const struct shader_filter_data *filter, gs_eparam_t *param,
+				     const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_vec2(param, &filter->uv_pixel_interval);
+}
+
+static void upload_uv_size(const struct shader_filter_data *filter, gs_eparam_t *param, const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_vec2(param, &filter->uv_size);
+}
+
+static void upload_current_time_ms(const struct shader_filter_data *filter, gs_eparam_t *param,
+				   const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(filter);
+	gs_effect_set_int(param, clock->wall_ms);
+}
+
+static void upload_current_time_sec(const struct shader_filter_data *filter, gs_eparam_t *param,
+				    const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(filter);
+	gs_effect_set_int(param, clock->local.tm_sec);
+}
+
+static void upload_current_time_min(const struct shader_filter_data *filter, gs_eparam_t *param,
+				    const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(filter);
+	gs_effect_set_int(param, clock->local.tm_min);
+}
+
+static void upload_current_time_hour(const struct shader_filter_data *filter, gs_eparam_t *param,
+				     const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(filter);
+	gs_effect_set_int(param, clock->local.tm_hour);
+}
+
+static void upload_current_time_day_of_week(const struct shader_filter_data *filter, gs_eparam_t *param,
+					    const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(filter);
+	gs_effect_set_int(param, clock->local.tm_wday);
+}
+
+static void upload_current_time_day_of_month(const struct shader_filter_data *filter, gs_eparam_t *param,
+					     const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(filter);
+	gs_effect_set_int(param, clock->local.tm_mday);
+}
+
+static void upload_current_time_month(const struct shader_filter_data *filter, gs_eparam_t *param,
+				      const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(filter);
+	gs_effect_set_int(param, clock->local.tm_mon);
+}
+
+static void upload_current_time_day_of_year(const struct shader_filter_data *filter, gs_eparam_t *param,
+					    const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(filter);
+	gs_effect_set_int(param, clock->local.tm_yday);
+}
+
+static void upload_current_time_year(const struct shader_filter_data *filter, gs_eparam_t *param,
+				     const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(filter);
+	gs_effect_set_int(param, clock->local.tm_year);
+}
+
+static void upload_elapsed_time(const struct shader_filter_data *filter, gs_eparam_t *param,
+				const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->elapsed_time);
+}
+
+static void upload_elapsed_time_start(const struct shader_filter_data *filter, gs_eparam_t *param,
+				      const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->elapsed_time - filter->shader_start_time);
+}
+
+static void upload_elapsed_time_show(const struct shader_filter_data *filter, gs_eparam_t *param,
+				     const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->shader_show_time);
+}
+
+static void upload_elapsed_time_active(const struct shader_filter_data *filter, gs_eparam_t *param,
+				       const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->shader_active_time);
+}
+
+static void upload_elapsed_time_enable(const struct shader_filter_data *filter, gs_eparam_t *param,
+				       const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->elapsed_time - filter->shader_enable_time);
+}
+
+static void upload_loops(const struct shader_filter_data *filter, gs_eparam_t *param, const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_int(param, filter->loops);
+}
+
+static void upload_loop_second(const struct shader_filter_data *filter, gs_eparam_t *param,
+			       const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->elapsed_time_loop);
+}
+
+static void upload_local_time(const struct shader_filter_data *filter, gs_eparam_t *param, const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->local_time);
+}
+
+static void upload_rand_f(const struct shader_filter_data *filter, gs_eparam_t *param, const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->rand_f);
+}
+
+static void upload_rand_instance_f(const struct shader_filter_data *filter, gs_eparam_t *param,
+				   const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->rand_instance_f);
+}
+
+static void upload_rand_activation_f(const struct shader_filter_data *filter, gs_eparam_t *param,
+				     const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->rand_activation_f);
+}
+
+static void upload_audio_peak(const struct shader_filter_data *filter, gs_eparam_t *param, const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->audio_peak);
+}
+
+static void upload_audio_magnitude(const struct shader_filter_data *filter, gs_eparam_t *param,
+				   const struct frame_clock *clock)
+{
+	UNUSED_PARAMETER(clock);
+	gs_effect_set_float(param, filter->audio_magnitude);
+}
+
+struct shader_builtin_info {
+	const char *name;
+	bool transition_only;
+	/* NULL for builtins that are set by the render callbacks. */
+	shader_builtin_upload_t upload;
+};
+
+static const struct shader_builtin_info shader_builtins[SHADER_BUILTIN_COUNT] = {
+	[SHADER_BUILTIN_UV_OFFSET] = {"uv_offset", false, upload_uv_offset},
+	[SHADER_BUILTIN_UV_SCALE] = {"uv_scale", false, upload_uv_scale},
+	[SHADER_BUILTIN_UV_PIXEL_INTERVAL] = {"uv_pixel_interval", false, upload_uv_pixel_interval},
+	[SHADER_BUILTIN_UV_SIZE] = {"uv_size", false, upload_uv_size},
+	[SHADER_BUILTIN_CURRENT_TIME_MS] = {"current_time_ms", false, upload_current_time_ms},
+	[SHADER_BUILTIN_CURRENT_TIME_SEC] = {"current_time_sec", false, upload_current_time_sec},
+	[SHADER_BUILTIN_CURRENT_TIME_MIN] = {"current_time_min", false, upload_current_time_min},
+	[SHADER_BUILTIN_CURRENT_TIME_HOUR] = {"current_time_hour", false, upload_current_time_hour},
+	[SHADER_BUILTIN_CURRENT_TIME_DAY_OF_WEEK] = {"current_time_day_of_week", false, upload_current_time_day_of_week},
+	[SHADER_BUILTIN_CURRENT_TIME_DAY_OF_MONTH] = {"current_time_day_of_month", false, upload_current_time_day_of_month},
+	[SHADER_BUILTIN_CURRENT_TIME_MONTH] = {"current_time_month", false, upload_current_time_month},
+	[SHADER_BUILTIN_CURRENT_TIME_DAY_OF_YEAR] = {"current_time_day_of_year", false, upload_current_time_day_of_year},
+	[SHADER_BUILTIN_CURRENT_TIME_YEAR] = {"current_time_year", false, upload_current_time_year},
+	[SHADER_BUILTIN_ELAPSED_TIME] = {"elapsed_time", false, upload_elapsed_time},
+	[SHADER_BUILTIN_ELAPSED_TIME_START] = {"elapsed_time_start", false, upload_elapsed_time_start},
+	[SHADER_BUILTIN_ELAPSED_TIME_SHOW] = {"elapsed_time_show", false, upload_elapsed_time_show},
+	[SHADER_BUILTIN_ELAPSED_TIME_ACTIVE] = {"elapsed_time_active", false, upload_elapsed_time_active},
+	[SHADER_BUILTIN_ELAPSED_TIME_ENABLE] = {"elapsed_time_enable", false, upload_elapsed_time_enable},
+	[SHADER_BUILTIN_LOOPS] = {"loops", false, upload_loops},
+	[SHADER_BUILTIN_LOOP_SECOND] = {"loop_second", false, upload_loop_second},
+	[SHADER_BUILTIN_LOCAL_TIME] = {"local_time", false, upload_local_time},
+	[SHADER_BUILTIN_RAND_F] = {"rand_f", false, upload_rand_f},
+	[SHADER_BUILTIN_RAND_INSTANCE_F] = {"rand_instance_f", false, upload_rand_instance_f},
+	[SHADER_BUILTIN_RAND_ACTIVATION_F] = {"rand_activation_f", false, upload_rand_activation_f},
+	[SHADER_BUILTIN_AUDIO_PEAK] = {"audio_peak", false, upload_audio_peak},
+	[SHADER_BUILTIN_AUDIO_MAGNITUDE] = {"audio_magnitude", false, upload_audio_magnitude},
+	[SHADER_BUILTIN_IMAGE] = {"image", false, NULL},
+	[SHADER_BUILTIN_PREVIOUS_IMAGE] = {"previous_image", false, NULL},
+	[SHADER_BUILTIN_PREVIOUS_OUTPUT] = {"previous_output", false, NULL},
+	[SHADER_BUILTIN_IMAGE_A] = {"image_a", true, NULL},
+	[SHADER_BUILTIN_IMAGE_B] = {"image_b", true, NULL},
+	[SHADER_BUILTIN_TRANSITION_TIME] = {"transition_time", true, NULL},
+	[SHADER_BUILTIN_CONVERT_LINEAR] = {"convert_linear", true, NULL},
+	[SHADER_BUILTIN_VIEW_PROJ] = {"ViewProj", false, NULL},
+};
+
+#define SHADER_BUILTIN_SLOT_BITS 6
+#define SHADER_BUILTIN_HASH_SEED 87884u
+
+/*
+ * FNV-1a with a seed picked so that every builtin name lands in its own slot
+ * of shader_builtin_slots. Adding a builtin means searching for a new seed and
+ * regenerating the slots; obs_module_load checks the table.
+ */
+static inline uint32_t shader_builtin_hash(const char *name, size_t len)
+{
+	uint32_t hash = SHADER_BUILTIN_HASH_SEED;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
 	}
+	return hash >> (32 - SHADER_BUILTIN_SLOT_BITS);
+}
+
+/* The builtin id plus one for every hash slot, zero for empty slots. */
+static const uint8_t shader_builtin_slots[1 << SHADER_BUILTIN_SLOT_BITS] = {
+	[2] = SHADER_BUILTIN_IMAGE + 1,
+	[3] = SHADER_BUILTIN_AUDIO_MAGNITUDE + 1,
+	[6] = SHADER_BUILTIN_TRANSITION_TIME + 1,
+	[8] = SHADER_BUILTIN_CURRENT_TIME_SEC + 1,
+	[10] = SHADER_BUILTIN_ELAPSED_TIME_ENABLE + 1,
+	[11] = SHADER_BUILTIN_CURRENT_TIME_DAY_OF_WEEK + 1,
+	[13] = SHADER_BUILTIN_UV_PIXEL_INTERVAL + 1,
+	[15] = SHADER_BUILTIN_UV_SCALE + 1,
+	[17] = SHADER_BUILTIN_CURRENT_TIME_MS + 1,
+	[21] = SHADER_BUILTIN_RAND_F + 1,
+	[22] = SHADER_BUILTIN_CONVERT_LINEAR + 1,
+	[23] = SHADER_BUILTIN_ELAPSED_TIME_ACTIVE + 1,
+	[24] = SHADER_BUILTIN_ELAPSED_TIME + 1,
+	[25] = SHADER_BUILTIN_VIEW_PROJ + 1,
+	[26] = SHADER_BUILTIN_LOOPS + 1,
+	[28] = SHADER_BUILTIN_CURRENT_TIME_DAY_OF_YEAR + 1,
+	[29] = SHADER_BUILTIN_LOCAL_TIME + 1,
+	[30] = SHADER_BUILTIN_CURRENT_TIME_HOUR + 1,
+	[31] = SHADER_BUILTIN_RAND_ACTIVATION_F + 1,
+	[36] = SHADER_BUILTIN_CURRENT_TIME_DAY_OF_MONTH + 1,
+	[37] = SHADER_BUILTIN_RAND_INSTANCE_F + 1,
+	[40] = SHADER_BUILTIN_AUDIO_PEAK + 1,
+	[41] = SHADER_BUILTIN_UV_SIZE + 1,
+	[46] = SHADER_BUILTIN_CURRENT_TIME_YEAR + 1,
+	[47] = SHADER_BUILTIN_PREVIOUS_IMAGE + 1,
+	[48] = SHADER_BUILTIN_PREVIOUS_OUTPUT + 1,
+	[54] = SHADER_BUILTIN_LOOP_SECOND + 1,
+	[55] = SHADER_BUILTIN_ELAPSED_TIME_SHOW + 1,
+	[56] = SHADER_BUILTIN_ELAPSED_TIME_START + 1,
+	[57] = SHADER_BUILTIN_IMAGE_B + 1,
+	[58] = SHADER_BUILTIN_IMAGE_A + 1,
+	[59] = SHADER_BUILTIN_CURRENT_TIME_MONTH + 1,
+	[61] = SHADER_BUILTIN_CURRENT_TIME_MIN + 1,
+	[63] = SHADER_BUILTIN_UV_OFFSET + 1,
+};
+
+/* Returns the builtin called name, or SHADER_BUILTIN_COUNT if there is none. */
+static enum shader_builtin shader_builtin_lookup(const char *name, size_t len)
+{
+	uint8_t slot = shader_builtin_slots[shader_builtin_hash(name, len)];
+	if (!slot)
+		return SHADER_BUILTIN_COUNT;
+	const char *builtin = shader_builtins[slot - 1].name;
+	if (strncmp(builtin, name, len) != 0 || builtin[len] != '\0')
+		return SHADER_BUILTIN_COUNT;
+	return (enum shader_builtin)(slot - 1);
+}
+
+static bool shader_builtin_table_valid(void)
+{
+	for (int i = 0; i < SHADER_BUILTIN_COUNT; i++) {
+		const char *name = shader_builtins[i].name;
+		if (shader_builtin_lookup(name, strlen(name)) != (enum shader_builtin)i)
+			return false;
+	}
+	return true;
+}
+
+/* Builtin uniforms that may be dropped from the effect when nothing uses them. */
+static bool is_strippable_builtin_uniform(const char *name, size_t len)
+{
+	enum shader_builtin id = shader_builtin_lookup(name, len);
+	return id != SHADER_BUILTIN_COUNT && id != SHADER_BUILTIN_VIEW_PROJ;
+}
+
+enum strip_item_kind {
+	STRIP_ITEM_ROOT,
+	STRIP_ITEM_FUNCTION,
+	STRIP_ITEM_UNIFORM,
+};
+
+/* A top-level statement or definition of the effect text. */
+struct strip_item {
+	enum strip_item_kind kind;
+	const char *start;
+	const char *end;
+	const char *name;
+	size_t name_len;
+	const char *first_ident;
+	size_t first_ident_len;
+	size_t first_ref;
+	size_t num_refs;
+	bool has_paren;
+	bool has_assign;
+	bool has_annotation;
+	bool has_directive;
+	bool name_fixed;
+	int angle_depth;
+	bool live;
+};
+
+struct strip_ref {
+	const char *name;
+	size_t len;
+};
+
+static bool strip_item_is(const struct strip_item *item, const char *keyword)
+{
+	size_t len = strlen(keyword);
+	return item->first_ident_len == len && strncmp(item->first_ident, keyword, len) == 0;
+}
+
+/*
+ * Drops top-level functions and builtin uniforms that nothing outside of a
+ * function references, directly or through other live functions. Anything
+ * the scanner does not understand, like preprocessor lines inside a
+ * definition, is kept. Removed text is replaced by its newlines so compiler
+ * errors still report the original line numbers.
+ */
+static void strip_unreachable_code(struct dstr *effect_text)
+{
+	if (!effect_text->len)
+		return;
+
+	DARRAY(struct strip_item) items;
+	DARRAY(struct strip_ref) refs;
+	da_init(items);
+	da_init(refs);
+
+	const char *text = effect_text->array;
+	const char *cur = text;
+	struct strip_item *item = NULL;
+	int depth = 0;
+	bool line_start = true;
+
+	while (*cur) {
+		char ch = *cur;
+		if (ch == '\n') {
+			line_start = true;
+			cur++;
+			continue;
+		}
+		if (ch == ' ' || ch == '\t' || ch == '\r') {
+			cur++;
+			continue;
+		}
+		if (ch == '/' && cur[1] == '/') {
+			while (*cur && *cur != '\n')
+				cur++;
+			continue;
+		}
+		if (ch == '/' && cur[1] == '*') {
+			const char *end = strstr(cur + 2, "*/");
+			cur = end ? end + 2 : cur + strlen(cur);
+			continue;
+		}
+
+		bool directive = line_start && ch == '#';
+		bool standalone = !item;
+		line_start = false;
+		if (!item) {
+			item = da_push_back_new(items);
+			item->start = cur;
+			item->first_ref = refs.num;
+		}
+
+		if (directive) {
+			// Identifiers on preprocessor lines count as references of the enclosing item.
+			item->has_directive = true;
+			while (*cur && *cur != '\n') {
+				if (*cur == '\\' && (cur[1] == '\n' || (cur[1] == '\r' && cur[2] == '\n'))) {
+					cur += cur[1] == '\r' ? 3 : 2;
+					continue;
+				}
+				if (is_var_char(*cur) && !(*cur >= '0' && *cur <= '9')) {
+					struct strip_ref *ref = da_push_back_new(refs);
+					ref->name = cur;
+					while (is_var_char(*cur))
+						cur++;
+					ref->len = cur - ref->name;
+					continue;
+				}
+				cur++;
+			}
+			item->num_refs = refs.num - item->first_ref;
+			if (standalone) {
+				item->end = cur;
+				item = NULL;
+			}
+			continue;
+		}
+
+		if (ch == '"') {
+			for (cur++; *cur && *cur != '"'; cur++) {
+				if (*cur == '\\' && cur[1])
+					cur++;
+			}
+			if (*cur)
+				cur++;
+			continue;
+		}
+
+		if (ch >= '0' && ch <= '9') {
+			while (is_var_char(*cur) || *cur == '.')
+				cur++;
+			continue;
+		}
+
+		if (is_var_char(ch)) {
+			const char *ident = cur;
+			while (is_var_char(*cur))
+				cur++;
+			size_t len = cur - ident;
+			struct strip_ref *ref = da_push_back_new(refs);
+			ref->name = ident;
+			ref->len = len;
+			item->num_refs = refs.num - item->first_ref;
+			if (depth == 0) {
+				if (!item->first_ident) {
+					item->first_ident = ident;
+					item->first_ident_len = len;
+				}
+				if (!item->name_fixed && item->angle_depth == 0) {
+					item->name = ident;
+					item->name_len = len;
+				}
+			}
+			continue;
+		}
+
+		cur++;
+		if (depth > 0) {
+			if (ch == '{') {
+				depth++;
+			} else if (ch == '}' && --depth == 0) {
+				item->end = cur;
+				item = NULL;
+			}
+			continue;
+		}
+
+		bool uniform = strip_item_is(item, "uniform");
+		if (uniform && ch == '<') {
+			item->name_fixed = true;
+			item->has_annotation = true;
+			item->angle_depth++;
+		} else if (uniform && ch == '>') {
+			item->angle_depth--;
+		} else if (item->angle_depth > 0) {
+			// Inside annotations, which may contain their own ';'.
+		} else if (ch == '(') {
+			item->name_fixed = true;
+			item->has_paren = true;
+		} else if (ch == '=') {
+			item->name_fixed = true;
+			item->has_assign = true;
+		} else if (ch == ':') {
+			item->name_fixed = true;
+		} else if (ch == ';') {
+			item->end = cur;
+			if (uniform && !item->has_annotation && item->name && !item->has_directive &&
+			    is_strippable_builtin_uniform(item->name, item->name_len))
+				item->kind = STRIP_ITEM_UNIFORM;
+			item = NULL;
+		} else if (ch == '{') {
+			depth++;
+			if (item->has_paren && !item->has_assign && !item->has_directive && !strip_item_is(item, "struct") &&
+			    !strip_item_is(item, "technique") && !strip_item_is(item, "technique11") &&
+			    !strip_item_is(item, "sampler_state") && !uniform)
+				item->kind = STRIP_ITEM_FUNCTION;
+		}
+	}
+
+	// Unterminated or directive-bearing definitions are left alone.
+	for (size_t i = 0; i < items.num; i++) {
+		if (!items.array[i].end || items.array[i].has_directive)
+			items.array[i].kind = STRIP_ITEM_ROOT;
+	}
+
+	DARRAY(size_t) pending;
+	DARRAY(size_t) candidates;
+	da_init(pending);
+	da_init(candidates);
+	for (size_t i = 0; i < items.num; i++) {
+		if (items.array[i].kind == STRIP_ITEM_ROOT) {
+			items.array[i].live = true;
+			da_push_back(pending, &i);
+		} else {
+			da_push_back(candidates, &i);
+		}
+	}
+	while (pending.num && candidates.num) {
+		struct strip_item *live = items.array + pending.array[pending.num - 1];
+		da_pop_back(pending);
+		for (size_t r = live->first_ref; r < live->first_ref + live->num_refs; r++) {
+			struct strip_ref *ref = refs.array + r;
+			for (size_t c = 0; c < candidates.num; c++) {
+				struct strip_item *target = items.array + candidates.array[c];
+				if (target->live || target->name_len != ref->len || strncmp(target->name, ref->name, ref->len) != 0)
+					continue;
+				target->live = true;
+				da_push_back(pending, &candidates.array[c]);
+			}
+		}
+	}
+	da_free(candidates);
+	da_free(pending);
+
+	size_t removed_functions = 0;
+	size_t removed_uniforms = 0;
+	struct dstr stripped = {0};
+	const char *copied = text;
+	for (size_t i = 0; i < items.num; i++) {
+		struct strip_item *dead = items.array + i;
+		if (dead->live)
+			continue;
+		if (dead->kind == STRIP_ITEM_FUNCTION)
+			removed_functions++;
+		else
+			removed_uniforms++;
+		dstr_ncat(&stripped, copied, dead->start - copied);
+		for (const char *pos = dead->start; pos < dead->end; pos++) {
+			if (*pos == '\n')
+				dstr_cat_ch(&stripped, '\n');
+		}
+		copied = dead->end;
+	}
+
+	if (removed_functions || removed_uniforms) {
+		dstr_cat(&stripped, copied);
+		dstr_move(effect_text, &stripped);
+		blog(LOG_DEBUG, "[obs-shaderfilter] stripped %zu unused functions and %zu unused builtin uniforms",
+		     removed_functions, removed_uniforms);
+	}
+	dstr_free(&stripped);
+	da_free(refs);
+	da_free(items);
+}
+
+enum shader_compile_status {
+	SHADER_COMPILE_OK,
+	SHADER_COMPILE_NO_FILE,
+	SHADER_COMPILE_LOAD_FAILED,
+};
+
+/*
+ * Reloads are split in two: a job on the compile queue reads and
+ * preprocesses the shader and builds the effect text, then the next video
+ * tick creates the effect and swaps it in. The previous effect keeps
+ * rendering until then. Permutations of specialized params take the same
+ * route, with variant_key set and source holding the base effect text.
+ */
+struct shader_define {
+	char *name;
+	char *value;
+};
+
+struct shader_compile_job {
+	volatile long refs;
+	volatile bool done;
+
+	bool from_file;
+	bool use_template;
+	bool opengl;
+	char *source;
+	char *variant_key;
+	DARRAY(struct shader_define) defines;
+
+	enum shader_compile_status status;
+	char *effect_text;
+	bool use_pm_alpha;
+	bool use_linear_input;
+	int input_mips;
+	shader_pass_target_array_t pass_targets;
+	shader_pass_map_t pass_map;
+	shader_path_array_t dependencies;
+};
+
+static os_task_queue_t *shader_compile_queue;
+
+/* Returns the level count of a "#define NEED_INPUT_MIPS n" line, 0 without one. */
+static int parse_input_mips(const char *text)
+{
+	static const char define[] = "#define NEED_INPUT_MIPS";
+	for (const char *pos = strstr(text, define); pos; pos = strstr(pos + 1, define)) {
+		if (pos != text && pos[-1] != '\n')
+			continue;
+		long levels = strtol(pos + sizeof(define) - 1, NULL, 10);
+		return levels < 0 ? 0 : levels > SHADER_MAX_INPUT_MIPS ? SHADER_MAX_INPUT_MIPS : (int)levels;
+	}
+	return 0;
+}
+
+static void free_pass_targets(shader_pass_target_array_t *targets, shader_pass_map_t *pass_map)
+{
+	for (size_t i = 0; i < targets->num; i++)
+		bfree(targets->array[i].name);
+	da_free(*targets);
+	da_free(*pass_map);
+}
+
+static void shader_compile_job_release(struct shader_compile_job *job)
+{
+	if (!job || os_atomic_dec_long(&job->refs) > 0)
+		return;
+	bfree(job->source);
+	bfree(job->variant_key);
+	for (size_t i = 0; i < job->defines.num; i++) {
+		bfree(job->defines.array[i].name);
+		bfree(job->defines.array[i].value);
+	}
+	da_free(job->defines);
+	bfree(job->effect_text);
+	free_pass_targets(&job->pass_targets, &job->pass_map);
+	free_shader_paths(&job->dependencies);
+	bfree(job);
+}
+
+static const struct {
+	const char *name;
+	enum gs_color_format format;
+} pass_target_formats[] = {
+	{"RGBA", GS_RGBA},   {"RGBA16F", GS_RGBA16F}, {"RGBA32F", GS_RGBA32F}, {"RG16F", GS_RG16F},
+	{"RG32F", GS_RG32F}, {"R16F", GS_R16F},       {"R32F", GS_R32F},       {"R8", GS_R8},
+};
+
+static size_t next_token(const char **pos, const char **token)
+{
+	const char *cur = *pos;
+	while (*cur == ' ' || *cur == '\t')
+		cur++;
+	*token = cur;
+	while (*cur && *cur != ' ' && *cur != '\t' && *cur != '\r' && *cur != '\n')
+		cur++;
+	*pos = cur;
+	return cur - *token;
+}
+
+/* Reads the PASS<n>_TARGET declarations, targets named more than once are shared by their passes. */
+static void parse_pass_targets(const char *text, shader_pass_target_array_t *targets, shader_pass_map_t *pass_map)
+{
+	static const char directive[] = "#define PASS";
+	for (const char *pos = strstr(text, directive); pos; pos = strstr(pos + 1, directive)) {
+		if (pos > text && pos[-1] != '\n')
+			continue;
+		char *end;
+		unsigned long pass = strtoul(pos + sizeof(directive) - 1, &end, 10);
+		if (end == pos + sizeof(directive) - 1 || strncmp(end, "_TARGET", 7) != 0 || is_var_char(end[7]))
+			continue;
+		if (pass >= SHADER_MAX_PASSES) {
+			blog(LOG_WARNING, "[obs-shaderfilter] PASS%lu_TARGET ignored, only %d passes can have targets", pass,
+			     SHADER_MAX_PASSES);
+			continue;
+		}
+
+		const char *cur = end + 7;
+		const char *token;
+		size_t len = next_token(&cur, &token);
+		if (!len) {
+			blog(LOG_WARNING, "[obs-shaderfilter] PASS%lu_TARGET does not name a texture", pass);
+			continue;
+		}
+
+		size_t index = 0;
+		while (index < targets->num && (strlen(targets->array[index].name) != len ||
+						strncmp(targets->array[index].name, token, len) != 0))
+			index++;
+		if (index == targets->num) {
+			struct shader_pass_target *target = da_push_back_new(*targets);
+			target->name = bstrdup_n(token, len);
+			target->scale = 1.0f;
+			target->format = GS_RGBA;
+
+			len = next_token(&cur, &token);
+			if (len) {
+				float scale = (float)strtod(token, NULL);
+				if (scale > 0.0f)
+					target->scale = fminf(scale, 1.0f);
+				len = next_token(&cur, &token);
+			}
+			if (len) {
+				size_t f = 0;
+				while (f < OBS_COUNTOF(pass_target_formats) &&
+				       (strlen(pass_target_formats[f].name) != len ||
+					astrcmpi_n(pass_target_formats[f].name, token, len) != 0))
+					f++;
+				if (f < OBS_COUNTOF(pass_target_formats))
+					target->format = pass_target_formats[f].format;
+				else
+					blog(LOG_WARNING, "[obs-shaderfilter] unknown format of pass target '%s', using RGBA",
+					     target->name);
+			}
+		}
+
+		while (pass_map->num <= pass)
+			*(size_t *)da_push_back_new(*pass_map) = 0;
+		pass_map->array[pass] = index + 1;
+	}
+}
+
+static void shader_compile_job_run(void *data)
+{
+	struct shader_compile_job *job = data;
 
 	// Load text and build the effect from the template, if necessary.
 	char *shader_text = NULL;
-	bool use_template = !obs_data_get_bool(settings, "override_entire_effect");
-
-	if (obs_data_get_bool(settings, "from_file")) {
-		const char *file_name = obs_data_get_string(settings, "shader_file_name");
-		if (!strlen(file_name)) {
-			obs_data_unset_user_value(settings, "last_error");
-			goto end;
+	if (job->from_file) {
+		if (!strlen(job->source)) {
+			job->status = SHADER_COMPILE_NO_FILE;
+			goto done;
 		}
-		shader_text = load_shader_from_file(file_name);
+		shader_text = load_shader_from_file(job->source, &job->dependencies);
 		if (!shader_text) {
-			obs_data_set_string(settings, "last_error", obs_module_text("ShaderFilter.FileLoadFailed"));
-			goto end;
+			job->status = SHADER_COMPILE_LOAD_FAILED;
+			goto done;
 		}
 	} else {
-		shader_text = bstrdup(obs_data_get_string(settings, "shader_text"));
-		use_template = true;
+		shader_text = bstrdup(job->source);
 	}
-	filter->use_template = use_template;
 
 	struct dstr effect_text = {0};
 
-	if (use_template) {
+	if (job->opengl)
+		dstr_cat(&effect_text, "#define OPENGL 1\n");
+
+	if (job->use_template) {
 		dstr_cat(&effect_text, effect_template_begin);
 	}
 
@@ -584,48 +1967,136 @@ static void shader_filter_reload_effect(struct shader_filter_data *filter)
 		bfree(shader_text);
 	}
 
-	if (use_template) {
+	if (job->use_template) {
 		dstr_cat(&effect_text, effect_template_end);
 	}
 
-	// Create the effect.
-	char *errors = NULL;
-
-	obs_enter_graphics();
-	int device_type = gs_get_device_type();
-	if (device_type == GS_DEVICE_OPENGL) {
+	if (job->opengl)
 		dstr_replace(&effect_text, "[loop]", "");
-		dstr_insert(&effect_text, 0, "#define OPENGL 1\n");
-	}
 
-	if (effect_text.len && dstr_find(&effect_text, "#define USE_PM_ALPHA 1")) {
-		filter->use_pm_alpha = true;
-	} else {
-		filter->use_pm_alpha = false;
+	strip_unreachable_code(&effect_text);
+
+	job->use_pm_alpha = effect_text.len && dstr_find(&effect_text, "#define USE_PM_ALPHA 1");
+	job->use_linear_input = effect_text.len && dstr_find(&effect_text, "#define USE_LINEAR_INPUT 1");
+	if (effect_text.len) {
+		parse_pass_targets(effect_text.array, &job->pass_targets, &job->pass_map);
+		job->input_mips = parse_input_mips(effect_text.array);
 	}
+	job->effect_text = effect_text.array;
+	job->status = SHADER_COMPILE_OK;
+
+done:
+	os_atomic_store_bool(&job->done, true);
+	shader_compile_job_release(job);
+}
+
+static void shader_filter_reload_effect(struct shader_filter_data *filter)
+{
+	obs_data_t *settings = shader_filter_get_settings(filter);
 
-	if (filter->effect)
-		gs_effect_destroy(filter->effect);
-	filter->effect = gs_effect_create(effect_text.array, NULL, &errors);
+	struct shader_compile_job *job = bzalloc(sizeof(struct shader_compile_job));
+	job->refs = 2;
+	job->from_file = obs_data_get_bool(settings, "from_file");
+	job->use_template = !job->from_file || !obs_data_get_bool(settings, "override_entire_effect");
+	job->source = bstrdup(obs_data_get_string(settings, job->from_file ? "shader_file_name" : "shader_text"));
+	obs_data_release(settings);
+
+	obs_enter_graphics();
+	job->opengl = gs_get_device_type() == GS_DEVICE_OPENGL;
 	obs_leave_graphics();
 
-	if (filter->effect == NULL) {
-		blog(LOG_WARNING, "[obs-shaderfilter] Unable to create effect. Errors returned from parser:\n%s",
-		     (errors == NULL || strlen(errors) == 0 ? "(None)" : errors));
-		if (errors && strlen(errors)) {
-			obs_data_set_string(settings, "last_error", errors);
-		} else {
-			obs_data_set_string(settings, "last_error", obs_module_text("ShaderFilter.Unknown"));
+	// A newer request supersedes one that is still queued or running.
+	shader_compile_job_release(filter->compile_job);
+	filter->compile_job = job;
+
+	if (!shader_compile_queue || !os_task_queue_queue_task(shader_compile_queue, shader_compile_job_run, job))
+		shader_compile_job_run(job);
+}
+
+/* Binds param to the builtin uniform called name, returns false for user params. */
+static bool shader_filter_bind_builtin_param(struct shader_filter_data *filter, const char *name, gs_eparam_t *param)
+{
+	enum shader_builtin id = shader_builtin_lookup(name, strlen(name));
+	if (id == SHADER_BUILTIN_COUNT || (shader_builtins[id].transition_only && !filter->transition))
+		return false;
+	filter->builtin_params[id] = param;
+	filter->used_builtins |= SHADER_BUILTIN_BIT(id);
+	return true;
+}
+
+/* Binds param to image_mip<n>, returns false for other names and levels the shader did not ask for. */
+static bool shader_filter_bind_input_mip(struct shader_filter_data *filter, const char *name, gs_eparam_t *param)
+{
+	if (strncmp(name, "image_mip", 9) != 0 || name[9] < '1' || name[9] > '9' || name[10])
+		return false;
+	int level = name[9] - '0';
+	if (level > filter->input_mips)
+		return false;
+	filter->input_mip_params[level - 1] = param;
+	return true;
+}
+
+/* Binds param to the pass target called name, returns false if no pass renders into it. */
+static bool shader_filter_bind_pass_target(struct shader_filter_data *filter, const char *name, gs_eparam_t *param)
+{
+	for (size_t i = 0; i < filter->pass_targets.num; i++) {
+		if (strcmp(filter->pass_targets.array[i].name, name) == 0) {
+			filter->pass_targets.array[i].param = param;
+			return true;
 		}
-		dstr_free(&effect_text);
-		bfree(errors);
-		goto end;
-	} else {
-		dstr_free(&effect_text);
-		obs_data_unset_user_value(settings, "last_error");
 	}
+	return false;
+}
 
-	// Store references to the new effect's parameters.
+/* Resolves a texture path from the effect like the file picker would, NULL if there is no such file. */
+static char *resolve_default_texture_path(const char *path)
+{
+	if (!path || !*path)
+		return NULL;
+	if (os_file_exists(path))
+		return os_get_abs_path_ptr(path);
+
+	struct dstr texture_path = {0};
+	dstr_copy(&texture_path, obs_get_module_data_path(obs_current_module()));
+	dstr_cat(&texture_path, "/textures/");
+	dstr_cat(&texture_path, path);
+	char *abs_path = os_get_abs_path_ptr(texture_path.array);
+	dstr_free(&texture_path);
+	if (abs_path && !os_file_exists(abs_path)) {
+		bfree(abs_path);
+		abs_path = NULL;
+	}
+	return abs_path;
+}
+
+/* Caches the effect default and the settings keys of a param that shader_filter_update reads. */
+static void shader_filter_prepare_param(struct effect_param_data *param, gs_eparam_t *effect_param)
+{
+	param->effect_default = gs_effect_get_default_val(effect_param);
+
+	switch (param->type) {
+	case GS_SHADER_PARAM_VEC2:
+	case GS_SHADER_PARAM_VEC3:
+	case GS_SHADER_PARAM_VEC4:
+		for (size_t i = 0; i < OBS_COUNTOF(param->component_keys); i++)
+			dstr_printf(&param->component_keys[i], "%s_%zu", param->name.array, i);
+		break;
+	case GS_SHADER_PARAM_TEXTURE:
+		dstr_copy_dstr(&param->source_key, &param->name);
+		dstr_cat(&param->source_key, "_source");
+		param->default_texture_path = resolve_default_texture_path(param->effect_default);
+		break;
+	case GS_SHADER_PARAM_STRING:
+		if (param->effect_default)
+			param->default_value.string = bstrdup(param->effect_default);
+		break;
+	default:;
+	}
+}
+
+static void shader_filter_load_effect_params(struct shader_filter_data *filter)
+{
+	filter->param_generation = os_atomic_inc_long(&shader_param_generation);
 	size_t effect_count = gs_effect_get_num_params(filter->effect);
 	for (size_t effect_index = 0; effect_index < effect_count; effect_index++) {
 		gs_eparam_t *param = gs_effect_get_param_by_idx(filter->effect, effect_index);
@@ -634,79 +2105,16 @@ static void shader_filter_reload_effect(struct shader_filter_data *filter)
 		struct gs_effect_param_info info;
 		gs_effect_get_param_info(param, &info);
 
-		if (strcmp(info.name, "uv_offset") == 0) {
-			filter->param_uv_offset = param;
-		} else if (strcmp(info.name, "uv_scale") == 0) {
-			filter->param_uv_scale = param;
-		} else if (strcmp(info.name, "uv_pixel_interval") == 0) {
-			filter->param_uv_pixel_interval = param;
-		} else if (strcmp(info.name, "uv_size") == 0) {
-			filter->param_uv_size = param;
-		} else if (strcmp(info.name, "current_time_ms") == 0) {
-			filter->param_current_time_ms = param;
-		} else if (strcmp(info.name, "current_time_sec") == 0) {
-			filter->param_current_time_sec = param;
-		} else if (strcmp(info.name, "current_time_min") == 0) {
-			filter->param_current_time_min = param;
-		} else if (strcmp(info.name, "current_time_hour") == 0) {
-			filter->param_current_time_hour = param;
-		} else if (strcmp(info.name, "current_time_day_of_week") == 0) {
-			filter->param_current_time_day_of_week = param;
-		} else if (strcmp(info.name, "current_time_day_of_month") == 0) {
-			filter->param_current_time_day_of_month = param;
-		} else if (strcmp(info.name, "current_time_month") == 0) {
-			filter->param_current_time_month = param;
-		} else if (strcmp(info.name, "current_time_day_of_year") == 0) {
-			filter->param_current_time_day_of_year = param;
-		} else if (strcmp(info.name, "current_time_year") == 0) {
-			filter->param_current_time_year = param;
-		} else if (strcmp(info.name, "elapsed_time") == 0) {
-			filter->param_elapsed_time = param;
-		} else if (strcmp(info.name, "elapsed_time_start") == 0) {
-			filter->param_elapsed_time_start = param;
-		} else if (strcmp(info.name, "elapsed_time_show") == 0) {
-			filter->param_elapsed_time_show = param;
-		} else if (strcmp(info.name, "elapsed_time_active") == 0) {
-			filter->param_elapsed_time_active = param;
-		} else if (strcmp(info.name, "elapsed_time_enable") == 0) {
-			filter->param_elapsed_time_enable = param;
-		} else if (strcmp(info.name, "rand_f") == 0) {
-			filter->param_rand_f = param;
-		} else if (strcmp(info.name, "rand_activation_f") == 0) {
-			filter->param_rand_activation_f = param;
-		} else if (strcmp(info.name, "rand_instance_f") == 0) {
-			filter->param_rand_instance_f = param;
-		} else if (strcmp(info.name, "loops") == 0) {
-			filter->param_loops = param;
-		} else if (strcmp(info.name, "loop_second") == 0) {
-			filter->param_loop_second = param;
-		} else if (strcmp(info.name, "local_time") == 0) {
-			filter->param_local_time = param;
-		} else if (strcmp(info.name, "audio_peak") == 0) {
-			filter->param_audio_peak = param;
-		} else if (strcmp(info.name, "audio_magnitude") == 0) {
-			filter->param_audio_magnitude = param;
-		} else if (strcmp(info.name, "ViewProj") == 0) {
-			// Nothing.
-		} else if (strcmp(info.name, "image") == 0) {
-			filter->param_image = param;
-		} else if (strcmp(info.name, "previous_image") == 0) {
-			filter->param_previous_image = param;
-		} else if (strcmp(info.name, "previous_output") == 0) {
-			filter->param_previous_output = param;
-		} else if (filter->transition && strcmp(info.name, "image_a") == 0) {
-			filter->param_image_a = param;
-		} else if (filter->transition && strcmp(info.name, "image_b") == 0) {
-			filter->param_image_b = param;
-		} else if (filter->transition && strcmp(info.name, "transition_time") == 0) {
-			filter->param_transition_time = param;
-		} else if (filter->transition && strcmp(info.name, "convert_linear") == 0) {
-			filter->param_convert_linear = param;
-		} else {
+		if (!shader_filter_bind_pass_target(filter, info.name, param) &&
+		    !shader_filter_bind_input_mip(filter, info.name, param) &&
+		    !shader_filter_bind_builtin_param(filter, info.name, param)) {
 			struct effect_param_data *cached_data = da_push_back_new(filter->stored_param_list);
 			dstr_copy(&cached_data->name, info.name);
 			cached_data->type = info.type;
-			cached_data->param = param;
+			struct effect_param_binding *binding = da_push_back_new(filter->param_bindings);
+			binding->param = param;
+			binding->type = info.type;
+			binding->needs_upload = true;
 			da_init(cached_data->option_values);
 			da_init(cached_data->option_labels);
 			const size_t annotation_count = gs_param_get_num_annotations(param);
@@ -788,14 +2196,20 @@ static void shader_filter_reload_effect(struct shader_filter_data *filter)
 						struct dstr *cs = da_insert_new(cached_data->option_labels, id);
 						*cs = val;
 					}
+				} else if (strcmp(info.name, "specialize") == 0 && info.type == GS_SHADER_PARAM_BOOL) {
+					cached_data->specialize = annotation_default && *(bool *)annotation_default;
 				}
 				bfree(annotation_default);
 			}
+			if (cached_data->specialize && cached_data->type != GS_SHADER_PARAM_BOOL &&
+			    cached_data->type != GS_SHADER_PARAM_INT) {
+				blog(LOG_WARNING, "[obs-shaderfilter] 'specialize' is only supported on bool and int params, ignored on '%s'",
+				     cached_data->name.array);
+				cached_data->specialize = false;
+			}
+			shader_filter_prepare_param(cached_data, param);
 		}
 	}
-
-end:
-	obs_data_release(settings);
 }
 
 static const char *shader_filter_get_name(void *unused)
@@ -815,35 +2229,66 @@ static int clamp_source_dimension(int value)
 	return value > 0 ? value : 1;
 }
 
-static void *shader_filter_create_internal(obs_data_t *settings, obs_source_t *source, bool source_mode)
+/* Gives every instance a different phase for update rate decimation. */
+static volatile long update_phase_counter = 0;
+
+static struct shader_filter_data *shader_filter_alloc(obs_data_t *settings, obs_source_t *source)
 {
 	struct shader_filter_data *filter = bzalloc(sizeof(struct shader_filter_data));
 	filter->context = source;
 	filter->reload_effect = true;
-	filter->source = source_mode;
 	filter->width = 1920;
 	filter->height = 1080;
+	filter->render_scale = 1.0f;
+	filter->update_phase = (uint32_t)os_atomic_inc_long(&update_phase_counter);
 	filter->uv_scale.x = 1.0f;
 	filter->uv_scale.y = 1.0f;
 	filter->uv_offset.x = 0.0f;
 	filter->uv_offset.y = 0.0f;
-	shader_filter_init_source_mode(settings);
 
 	dstr_init(&filter->last_path);
 	dstr_copy(&filter->last_path, obs_data_get_string(settings, "shader_file_name"));
 	filter->last_from_file = obs_data_get_bool(settings, "from_file");
 	filter->rand_instance_f = (float)((double)rand_interval(0, 10000) / (double)10000);
 	filter->rand_activation_f = (float)((double)rand_interval(0, 10000) / (double)10000);
+	filter->rand_state = os_gettime_ns() ^ (uint64_t)(uintptr_t)filter;
 
 	pthread_mutex_init(&filter->audio_mutex, NULL);
 
 	da_init(filter->stored_param_list);
+	da_init(filter->param_bindings);
+	da_init(filter->stages);
+	return filter;
+}
+
+static void *shader_filter_create_internal(obs_data_t *settings, obs_source_t *source, bool source_mode)
+{
+	shader_filter_init_source_mode(settings);
+	struct shader_filter_data *filter = shader_filter_alloc(settings, source);
+	filter->source = source_mode;
 	load_output_effect(filter);
 	obs_source_update(source, settings);
 
 	return filter;
 }
 
+static void shader_filter_update(void *data, obs_data_t *settings);
+
+/* Stages load a shader file with its default parameter values, .effect files replace the whole effect. */
+static struct shader_filter_data *shader_filter_create_stage(struct shader_filter_data *parent, const char *file_name)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_bool(settings, "from_file", true);
+	obs_data_set_string(settings, "shader_file_name", file_name);
+	const char *extension = os_get_path_extension(file_name);
+	obs_data_set_bool(settings, "override_entire_effect", extension && astrcmpi(extension, ".effect") == 0);
+
+	struct shader_filter_data *stage = shader_filter_alloc(settings, parent->context);
+	stage->stage_settings = settings;
+	shader_filter_update(stage, settings);
+	return stage;
+}
+
 static void *shader_filter_create(obs_data_t *settings, obs_source_t *source)
 {
 	return shader_filter_create_internal(settings, source, false);
@@ -852,16 +2297,31 @@ static void *shader_filter_create(obs_data_t *settings, obs_source_t *source)
 static void shader_filter_destroy(void *data)
 {
 	struct shader_filter_data *filter = data;
+	shader_compile_job_release(filter->compile_job);
 	shader_filter_clear_params(filter);
 
+	for (size_t i = 0; i < filter->stages.num; i++)
+		shader_filter_destroy(filter->stages.array[i]);
+	da_free(filter->stages);
+
+	shader_path_array_t no_dependencies;
+	da_init(no_dependencies);
+	shader_watch_set_dependencies(filter, &no_dependencies);
+	shader_filter_clear_variants(filter);
+	bfree(filter->effect_text);
+	dstr_free(&filter->variant_key);
+
+	if (filter->uniform_uploads_skipped)
+		blog(LOG_DEBUG, "[obs-shaderfilter] skipped %llu of %llu parameter uploads left at their defaults",
+		     (unsigned long long)filter->uniform_uploads_skipped,
+		     (unsigned long long)(filter->uniform_uploads + filter->uniform_uploads_skipped));
+
 	obs_enter_graphics();
-	if (filter->effect)
-		gs_effect_destroy(filter->effect);
-	if (filter->output_effect)
-		gs_effect_destroy(filter->output_effect);
-	if (filter->input_texrender)
+	shared_effect_release(filter->base_effect);
+	shared_effect_release(filter->output_effect);
+	if (filter->input_texrender && !filter->input_leased)
 		gs_texrender_destroy(filter->input_texrender);
-	if (filter->output_texrender)
+	if (filter->output_texrender && !filter->output_leased)
 		gs_texrender_destroy(filter->output_texrender);
 	if (filter->previous_input_texrender)
 		gs_texrender_destroy(filter->previous_input_texrender);
@@ -871,8 +2331,11 @@ static void shader_filter_destroy(void *data)
 		gs_vertexbuffer_destroy(filter->sprite_buffer);
 	obs_leave_graphics();
 
+	free_pass_targets(&filter->pass_targets, &filter->pass_map);
 	dstr_free(&filter->last_path);
 	da_free(filter->stored_param_list);
+	da_free(filter->param_bindings);
+	da_free(filter->interp_pairs);
 
 	if (filter->volmeter)
 		obs_volmeter_destroy(filter->volmeter);
@@ -880,6 +2343,7 @@ static void shader_filter_destroy(void *data)
 		bfree(filter->audio_source_name);
 
 	pthread_mutex_destroy(&filter->audio_mutex);
+	obs_data_release(filter->stage_settings);
 
 	bfree(filter);
 }
@@ -1025,1264 +2489,23 @@ static bool add_source_to_list(void *data, obs_source_t *source)
 	return true;
 }
 
-static bool is_var_char(char ch)
-{
-	return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
-}
-
-static void convert_if_defined(struct dstr *effect_text)
-{
-	char *pos = strstr(effect_text->array, "#if defined(");
-	while (pos) {
-		size_t diff = pos - effect_text->array;
-		char *ch = strstr(effect_text->array + diff + 12, ")\n");
-		pos = strstr(effect_text->array + diff + 12, "#if defined(");
-		if (ch && (!pos || ch < pos)) {
-			*ch = ' ';
-			dstr_remove(effect_text, diff, 12);
-			dstr_insert(effect_text, diff, "#ifdef ");
-			pos = strstr(effect_text->array + diff + 5, "#if defined(");
-		}
-	}
-}
-
-static void convert_atan(struct dstr *effect_text)
-{
-	char *pos = strstr(effect_text->array, "atan(");
-	while (pos) {
-		if (pos > effect_text->array && is_var_char(*(pos - 1))) {
-			pos = strstr(pos + 5, "atan(");
-			continue;
-		}
-
-		size_t diff = pos - effect_text->array;
-		size_t comma_off = SIZE_MAX;
-		size_t divide_off = SIZE_MAX;
-		size_t close_off = SIZE_MAX;
-
-		int depth = 1;
-		char *p = effect_text->array + diff + 5;
-		while (*p && depth > 0) {
-			if (*p == '/' && *(p + 1) == '/') {
-				while (*p && *p != '\n')
-					p++;
-				if (*p == '\n')
-					p++;
-				continue;
-			}
-			if (*p == '(') {
-				depth++;
-			} else if (*p == ')') {
-				depth--;
-				if (depth == 0)
-					close_off = p - effect_text->array;
-			} else if (*p == ',' && depth == 1) {
-				if (comma_off == SIZE_MAX)
-					comma_off = p - effect_text->array;
-			} else if (*p == '/' && depth == 1) {
-				if (divide_off == SIZE_MAX)
-					divide_off = p - effect_text->array;
-			}
-			p++;
-		}
-
-		if (close_off == SIZE_MAX) {
-			pos = strstr(effect_text->array + diff + 5, "atan(");
-			continue;
-		}
-
-		if (comma_off != SIZE_MAX && comma_off < close_off) {
-			dstr_insert(effect_text, diff + 4, "2");
-			pos = strstr(effect_text->array + diff + 6, "atan(");
-		} else if (divide_off != SIZE_MAX && divide_off < close_off) {
-			effect_text->array[divide_off] = ',';
-			dstr_insert(effect_text, diff + 4, "2");
-			pos = strstr(effect_text->array + diff + 6, "atan(");
-		} else {
-			pos = strstr(effect_text->array + diff + 5, "atan(");
-		}
-	}
-}
-
-static void insert_begin_of_block(struct dstr *effect_text, size_t diff, char *insert)
-{
-	int depth = 0;
-	char *ch = effect_text->array + diff;
-	while (ch > effect_text->array && (*ch == ' ' || *ch == '\t'))
-		ch--;
-	while (ch > effect_text->array) {
-		while (*ch != '=' && *ch != '(' && *ch != ')' && *ch != '+' && *ch != '-' && *ch != '/' && *ch != '*' &&
-		       *ch != ' ' && *ch != '\t' && ch > effect_text->array)
-			ch--;
-		if (*ch == '(') {
-			if (depth == 0) {
-				dstr_insert(effect_text, ch - effect_text->array + 1, insert);
-				return;
-			}
-			ch--;
-			depth--;
-		} else if (*ch == ')') {
-			ch--;
-			depth++;
-		} else if (*ch == '=') {
-			dstr_insert(effect_text, ch - effect_text->array + 1, insert);
-			return;
-		} else if (*ch == '+' || *ch == '-' || *ch == '/' || *ch == '*' || *ch == ' ' || *ch == '\t') {
-			if (depth == 0) {
-				dstr_insert(effect_text, ch - effect_text->array + 1, insert);
-				return;
-			}
-			ch--;
-		}
-	}
-}
-
-static void insert_end_of_block(struct dstr *effect_text, size_t diff, char *insert)
-{
-	int depth = 0;
-	char *ch = effect_text->array + diff;
-	while (*ch == ' ' || *ch == '\t')
-		ch++;
-	while (*ch != 0) {
-		while (*ch != ';' && *ch != '(' && *ch != ')' && *ch != '+' && *ch != '-' && *ch != '/' && *ch != '*' &&
-		       *ch != ' ' && *ch != '\t' && *ch != ',' && *ch != 0)
-			ch++;
-		if (*ch == '(') {
-			ch++;
-			depth++;
-		} else if (*ch == ')') {
-			if (depth == 0) {
-				dstr_insert(effect_text, ch - effect_text->array, insert);
-				return;
-			}
-			ch++;
-			depth--;
-		} else if (*ch == ';') {
-			dstr_insert(effect_text, ch - effect_text->array, insert);
-			return;
-		} else if (*ch == '+' || *ch == '-' || *ch == '/' || *ch == '*' || *ch == ' ' || *ch == '\t' || *ch == ',') {
-			if (depth == 0) {
-				dstr_insert(effect_text, ch - effect_text->array, insert);
-				return;
-			}
-			ch++;
-		}
-	}
-}
-
-static void convert_mat_mul_var(struct dstr *effect_text, struct dstr *var_function_name)
-{
-	char *pos = strstr(effect_text->array, var_function_name->array);
-	while (pos) {
-		if ((pos > effect_text->array && is_var_char(*(pos - 1))) ||
-		    is_var_char(*(pos + var_function_name->len))) {
-			pos = strstr(pos + var_function_name->len, var_function_name->array);
-			continue;
-		}
-		size_t diff = pos - effect_text->array;
-		char *ch = pos + var_function_name->len;
-		while (*ch == ' ' || *ch == '\t')
-			ch++;
-		if (*ch == '*' && *(ch + 1) != '=') {
-			size_t diff3 = ch - effect_text->array + 1;
-			*ch = ',';
-			insert_end_of_block(effect_text, diff3, ")");
-			dstr_insert(effect_text, diff, "mul(");
-			pos = strstr(effect_text->array + diff + 4 + var_function_name->len, var_function_name->array);
-			continue;
-		}
-		ch = pos - 1;
-		while ((*ch == ' ' || *ch == '\t') && ch > effect_text->array)
-			ch--;
-		if (*ch == '=' && *(ch - 1) == '*') {
-			char *end = ch - 2;
-			while ((*end == ' ' || *end == '\t') && end > effect_text->array)
-				end--;
-			char *start = end;
-			while ((is_var_char(*start) || *start == '.') && start > effect_text->array)
-				start--;
-			start++;
-			end++;
-
-			diff = ch - 1 - effect_text->array;
-
-			struct dstr insert = {0};
-			dstr_init_copy(&insert, "= mul(");
-			dstr_ncat(&insert, start, end - start);
-			dstr_cat(&insert, ",");
-			dstr_remove(effect_text, diff, 2);
-			dstr_insert(effect_text, diff, insert.array);
-
-			char *line_end = effect_text->array + diff;
-			while (*line_end != ';' && *line_end != 0)
-				line_end++;
-
-			dstr_insert(effect_text, line_end - effect_text->array, ")");
-
-			pos = strstr(effect_text->array + diff + insert.len + 1 + var_function_name->len, var_function_name->array);
-			dstr_free(&insert);
-
-			continue;
-		} else if (*ch == '*') {
-			size_t diff2 = ch - effect_text->array - 1;
-			*ch = ',';
-			insert_end_of_block(effect_text, diff + var_function_name->len, ")");
-			insert_begin_of_block(effect_text, diff2, "mul(");
-
-			pos = strstr(effect_text->array + diff + 4 + var_function_name->len, var_function_name->array);
-			continue;
-		}
-
-		pos = strstr(effect_text->array + diff + var_function_name->len, var_function_name->array);
-	}
-}
-
-static void convert_mat_mul(struct dstr *effect_text, char *var_type)
-{
-	size_t len = strlen(var_type);
-	char *pos = strstr(effect_text->array, var_type);
-	while (pos) {
-		if (pos > effect_text->array && is_var_char(*(pos - 1))) {
-			pos = strstr(pos + len, var_type);
-			continue;
-		}
-		size_t diff = pos - effect_text->array;
-		char *begin = pos + len;
-		if (diff > 0 && *begin == '(') {
-			char *ch = pos - 1;
-			while ((*ch == ' ' || *ch == '\t') && ch > effect_text->array)
-				ch--;
-			if (*ch == '=' && *(ch - 1) == '*') {
-				// mat constructor with *= in front of it
-				char *end = ch - 2;
-				while ((*end == ' ' || *end == '\t') && end > effect_text->array)
-					end--;
-				char *start = end;
-				while ((is_var_char(*start) || *start == '.') && start > effect_text->array)
-					start--;
-				start++;
-				end++;
-
-				size_t diff2 = ch - effect_text->array - 1;
-
-				struct dstr insert = {0};
-				dstr_init_copy(&insert, "= mul(");
-				dstr_ncat(&insert, start, end - start);
-				dstr_cat(&insert, ",");
-				dstr_remove(effect_text, diff2, 2);
-				dstr_insert(effect_text, diff2, insert.array);
-
-				char *line_end = effect_text->array + diff2;
-				while (*line_end != ';' && *line_end != 0)
-					line_end++;
-
-				dstr_insert(effect_text, line_end - effect_text->array, ")");
-
-				pos = strstr(effect_text->array + diff + insert.len + len + 1, var_type);
-				dstr_free(&insert);
-
-				continue;
-			} else if (*ch == '*') {
-				// mat constructor with * in front of it
-				size_t diff2 = ch - effect_text->array - 1;
-				*ch = ',';
-				insert_end_of_block(effect_text, diff + len, ")");
-				insert_begin_of_block(effect_text, diff2, "mul(");
-
-				pos = strstr(effect_text->array + diff + len + 4, var_type);
-				continue;
-			}
-
-			int depth = 1;
-			ch = begin + 1;
-			while (*ch != 0) {
-				while (*ch != ';' && *ch != '(' && *ch != ')' && *ch != '+' && *ch != '-' && *ch != '/' &&
-				       *ch != '*' && *ch != 0)
-					ch++;
-				if (*ch == '(') {
-					ch++;
-					depth++;
-				} else if (*ch == ')') {
-					if (depth == 0) {
-						break;
-					}
-					ch++;
-					depth--;
-				} else if (*ch == '*') {
-					if (depth == 0) {
-						//mat constructor follow by *
-						*ch = ',';
-						insert_end_of_block(effect_text, ch - effect_text->array + 1, ")");
-						dstr_insert(effect_text, diff, "mul(");
-						break;
-					}
-					ch++;
-				} else if (*ch == ';') {
-					break;
-				} else if (depth == 0) {
-					break;
-				} else if (*ch != 0) {
-					ch++;
-				}
-			}
-		}
-		if (*begin != ' ' && *begin != '\t') {
-			pos = strstr(pos + len, var_type);
-			continue;
-		}
-		while (*begin == ' ' || *begin == '\t')
-			begin++;
-		if (!is_var_char(*begin)) {
-			pos = strstr(pos + len, var_type);
-			continue;
-		}
-		char *end = begin;
-		while (is_var_char(*end))
-			end++;
-		struct dstr var_function_name = {0};
-		dstr_ncat(&var_function_name, begin, end - begin);
-
-		convert_mat_mul_var(effect_text, &var_function_name);
-		dstr_free(&var_function_name);
-
-		pos = strstr(effect_text->array + diff + len, var_type);
-	}
-}
-
-static bool is_in_function(struct dstr *effect_text, size_t diff)
-{
-	char *pos = effect_text->array + diff;
-	int depth = 0;
-	while (depth >= 0) {
-		char *end = strstr(pos, "}");
-		char *begin = strstr(pos, "{");
-		if (end && begin && begin < end) {
-			pos = begin + 1;
-			depth++;
-		} else if (end && begin && end < begin) {
-			pos = end + 1;
-			depth--;
-		} else if (end) {
-			pos = end + 1;
-			depth--;
-		} else if (begin && depth < 0) {
-			break;
-		} else if (begin) {
-			pos = begin + 1;
-			depth++;
-		} else {
-			break;
-		}
-	}
-	return depth != 0;
-}
-
-static void convert_init(struct dstr *effect_text, char *name)
-{
-	const size_t len = strlen(name);
-	char extra = 0;
-	char *pos = strstr(effect_text->array, name);
-	while (pos) {
-		size_t diff = pos - effect_text->array;
-		if (pos > effect_text->array && is_var_char(*(pos - 1))) {
-			pos = strstr(effect_text->array + diff + len, name);
-			continue;
-		}
-		char *ch = pos + len;
-		if (*ch >= '2' && *ch <= '9') {
-			extra = *ch;
-			ch++;
-		} else {
-			extra = 0;
-		}
-		if (*ch != ' ' && *ch != '\t') {
-			pos = strstr(effect_text->array + diff + len, name);
-			continue;
-		}
-		char *begin = pos - 1;
-		while (begin > effect_text->array && (*begin == ' ' || *begin == '\t'))
-			begin--;
-		if (*begin == '(' || *begin == ',' ||
-		    (is_var_char(*begin) && memcmp("uniform", begin - 6, 7) != 0 && memcmp("const", begin - 4, 5) != 0)) {
-			pos = strstr(effect_text->array + diff + len, name);
-			continue;
-		}
-		if (!is_in_function(effect_text, diff)) {
-			while (true) {
-				while (*ch != 0 && (*ch == ' ' || *ch == '\t'))
-					ch++;
-				while (is_var_char(*ch))
-					ch++;
-				while (*ch != 0 && (*ch == ' ' || *ch == '\t'))
-					ch++;
-				if (*ch != ',')
-					break;
-				*ch = ';';
-				diff = ch - effect_text->array;
-				dstr_insert(effect_text, diff + 1, " ");
-				if (extra) {
-					dstr_insert_ch(effect_text, diff + 1, extra);
-				}
-				dstr_insert(effect_text, diff + 1, name);
-				if (memcmp("const", begin - 4, 5) == 0) {
-					dstr_insert(effect_text, diff + 1, "\nconst ");
-					diff += 9;
-				} else {
-					dstr_insert(effect_text, diff + 1, "\nuniform ");
-					diff += 11;
-				}
-				if (extra)
-					diff++;
-				ch = effect_text->array + diff + len;
-			}
-
-			if ((*ch == '=' && *(ch + 1) != '=') || *ch == ';') {
-				if (memcmp("uniform", begin - 6, 7) != 0 && memcmp("const", begin - 4, 5) != 0) {
-					dstr_insert(effect_text, begin - effect_text->array + 1, "uniform ");
-					diff += 8;
-				}
-			}
-		}
-		pos = strstr(effect_text->array + diff + len, name);
-	}
-}
-
-static void convert_vector_init(struct dstr *effect_text, char *name, int count)
-{
-	const size_t len = strlen(name);
-
-	char *pos = strstr(effect_text->array, name);
-	while (pos) {
-		size_t diff = pos - effect_text->array;
-		char *ch = pos + len;
-		int depth = 0;
-		int function_depth = -1;
-		bool only_one = true;
-		bool only_numbers = true;
-		bool only_float = true;
-		while (*ch != 0 && (only_numbers || only_float)) {
-			if (*ch == '(') {
-				depth++;
-			} else if (*ch == ')') {
-				if (depth == 0) {
-					break;
-				}
-				depth--;
-				if (depth == function_depth) {
-					function_depth = -1;
-				}
-			} else if (*ch == ',') {
-				if (depth == 0) {
-					only_one = false;
-				}
-			} else if (*ch == ';') {
-				only_one = false;
-				break;
-			} else if (is_var_char(*ch) && (*ch < '0' || *ch > '9')) {
-				only_numbers = false;
-				char *begin = ch;
-				while (is_var_char(*ch))
-					ch++;
-				if (*ch == '.') {
-					size_t c = 1;
-					while (is_var_char(*(ch + c)))
-						c++;
-					if (c != 2 && function_depth < 0)
-						only_float = false;
-					ch += c - 1;
-				} else if (function_depth >= 0) {
-					ch--;
-				} else if (*ch == '(' &&
-					   (strncmp(begin, "length(", 7) == 0 || strncmp(begin, "float(", 6) == 0 ||
-					    strncmp(begin, "uint(", 5) == 0 || strncmp(begin, "int(", 4) == 0 ||
-					    strncmp(begin, "asfloat(", 8) == 0 || strncmp(begin, "asdouble(", 9) == 0 ||
-					    strncmp(begin, "asint(", 6) == 0 || strncmp(begin, "asuint(", 7) == 0 ||
-					    strncmp(begin, "determinant(", 12) == 0 || strncmp(begin, "distance(", 9) == 0 ||
-					    strncmp(begin, "dot(", 4) == 0 || strncmp(begin, "countbits(", 10) == 0 ||
-					    strncmp(begin, "firstbithigh(", 13) == 0 || strncmp(begin, "firstbitlow(", 12) == 0 ||
-					    strncmp(begin, "reversebits(", 12) == 0)) {
-					function_depth = depth;
-					depth++;
-				} else if (*ch == '(' &&
-					   (strncmp(begin, "abs(", 4) == 0 || strncmp(begin, "acos(", 5) == 0 ||
-					    strncmp(begin, "asin(", 5) == 0 || strncmp(begin, "atan(", 5) == 0 ||
-					    strncmp(begin, "atan2(", 6) == 0 || strncmp(begin, "ceil(", 5) == 0 ||
-					    strncmp(begin, "clamp(", 6) == 0 || strncmp(begin, "cos(", 4) == 0 ||
-					    strncmp(begin, "cosh(", 5) == 0 || strncmp(begin, "ddx(", 4) == 0 ||
-					    strncmp(begin, "ddy(", 4) == 0 || strncmp(begin, "degrees(", 8) == 0 ||
-					    strncmp(begin, "exp(", 4) == 0 || strncmp(begin, "exp2(", 5) == 0 ||
-					    strncmp(begin, "floor(", 6) == 0 || strncmp(begin, "fma(", 4) == 0 ||
-					    strncmp(begin, "fmod(", 5) == 0 || strncmp(begin, "frac(", 5) == 0 ||
-					    strncmp(begin, "frexp(", 6) == 0 || strncmp(begin, "fwidth(", 7) == 0 ||
-					    strncmp(begin, "ldexp(", 6) == 0 || strncmp(begin, "lerp(", 5) == 0 ||
-					    strncmp(begin, "log(", 4) == 0 || strncmp(begin, "log10(", 6) == 0 ||
-					    strncmp(begin, "log2(", 5) == 0 || strncmp(begin, "mad(", 4) == 0 ||
-					    strncmp(begin, "max(", 4) == 0 || strncmp(begin, "min(", 4) == 0 ||
-					    strncmp(begin, "modf(", 5) == 0 || strncmp(begin, "mod(", 4) == 0 ||
-					    strncmp(begin, "mul(", 4) == 0 || strncmp(begin, "normalize(", 10) == 0 ||
-					    strncmp(begin, "pow(", 4) == 0 || strncmp(begin, "radians(", 8) == 0 ||
-					    strncmp(begin, "rcp(", 4) == 0 || strncmp(begin, "reflect(", 8) == 0 ||
-					    strncmp(begin, "refract(", 8) == 0 || strncmp(begin, "round(", 6) == 0 ||
-					    strncmp(begin, "rsqrt(", 6) == 0 || strncmp(begin, "saturate(", 9) == 0 ||
-					    strncmp(begin, "sign(", 5) == 0 || strncmp(begin, "sin(", 4) == 0 ||
-					    strncmp(begin, "sincos(", 7) == 0 || strncmp(begin, "sinh(", 5) == 0 ||
-					    strncmp(begin, "smoothstep(", 11) == 0 || strncmp(begin, "sqrt(", 5) == 0 ||
-					    strncmp(begin, "step(", 5) == 0 || strncmp(begin, "tan(", 4) == 0 ||
-					    strncmp(begin, "tanh(", 5) == 0 || strncmp(begin, "transpose(", 10) == 0 ||
-					    strncmp(begin, "trunc(", 6) == 0)) {
-					depth++;
-				} else {
-					struct dstr find = {0};
-					bool found = false;
-					dstr_copy(&find, "float ");
-					dstr_ncat(&find, begin, ch - begin + (*ch == '(' ? 1 : 0));
-					char *t = strstr(effect_text->array, find.array);
-					while (t != NULL) {
-						t += find.len;
-						if (*ch == '(') {
-							found = true;
-							break;
-						} else if (!is_var_char(*t)) {
-							found = true;
-							break;
-						}
-						t = strstr(t, find.array);
-					}
-					if (!found) {
-						dstr_copy(&find, "int ");
-						dstr_ncat(&find, begin, ch - begin + (*ch == '(' ? 1 : 0));
-						t = strstr(effect_text->array, find.array);
-						while (t != NULL) {
-							t += find.len;
-							if (*ch == '(') {
-								found = true;
-								break;
-							} else if (!is_var_char(*t)) {
-								found = true;
-								break;
-							}
-							t = strstr(t, find.array);
-						}
-					}
-					if (!found && *ch != '(') {
-						dstr_copy(&find, "#define ");
-						dstr_ncat(&find, begin, ch - begin);
-						char *t = strstr(effect_text->array, find.array);
-						while (t != NULL) {
-							t += find.len;
-							if (!is_var_char(*t)) {
-								while (*t == ' ' || *t == '\t')
-									t++;
-								if (*t >= '0' && *t <= '9') {
-									found = true;
-									break;
-								}
-							}
-							t = strstr(t, find.array);
-						}
-					}
-					if (!found) {
-						only_float = false;
-					} else if (*ch == '(') {
-						function_depth = depth;
-					}
-					dstr_free(&find);
-					ch--;
-				}
-			} else if ((*ch < '0' || *ch > '9') && *ch != '.' && *ch != ' ' && *ch != '\t' && *ch != '+' &&
-				   *ch != '-' && *ch != '*' && *ch != '/') {
-				only_numbers = false;
-			}
-			ch++;
-		}
-		size_t end_diff = ch - effect_text->array;
-		if (count > 1 && only_one && (only_numbers || only_float)) {
-			//only 1 simple arg in the float4
-			struct dstr found = {0};
-			dstr_init(&found);
-			dstr_ncat(&found, pos, ch - pos + 1);
-
-			struct dstr replacement = {0};
-			dstr_init_copy(&replacement, name);
-			dstr_ncat(&replacement, pos + len, ch - (pos + len));
-			for (int i = 1; i < count; i++) {
-				dstr_cat(&replacement, ",");
-				dstr_ncat(&replacement, pos + len, ch - (pos + len));
-			}
-			dstr_cat(&replacement, ")");
-
-			dstr_replace(effect_text, found.array, replacement.array);
-
-			end_diff -= found.len;
-			end_diff += replacement.len;
-			dstr_free(&replacement);
-			dstr_free(&found);
-		}
-
-		if (!is_in_function(effect_text, diff)) {
-			char *begin = effect_text->array + diff - 1;
-			while (begin > effect_text->array && (*begin == ' ' || *begin == '\t'))
-				begin--;
-			if (*begin == '=') {
-				begin--;
-				while (begin > effect_text->array && (*begin == ' ' || *begin == '\t'))
-					begin--;
-				while (is_var_char(*begin))
-					begin--;
-				while (begin > effect_text->array && (*begin == ' ' || *begin == '\t'))
-					begin--;
-				if (memcmp(name, begin - len + 2, len - 1) == 0) {
-
-					begin -= len - 1;
-					while (begin > effect_text->array && (*begin == ' ' || *begin == '\t'))
-						begin--;
-					if (memcmp("uniform", begin - 6, 7) != 0 && memcmp("const", begin - 4, 5) != 0) {
-						dstr_insert(effect_text, begin - effect_text->array + 1, "uniform ");
-						diff += 8;
-						end_diff += 8;
-					}
-					if (effect_text->array[end_diff] == ')') {
-						if (count > 1) {
-							effect_text->array[end_diff] = '}';
-							dstr_remove(effect_text, diff, len);
-							dstr_insert(effect_text, diff, "{");
-						} else {
-							dstr_remove(effect_text, end_diff, 1);
-							dstr_remove(effect_text, diff, len);
-						}
-					}
-				}
-			}
-		}
-
-		pos = strstr(effect_text->array + diff + len, name);
-	}
-}
-
-static void convert_if0(struct dstr *effect_text)
-{
-	char *begin = strstr(effect_text->array, "#if 0");
-	while (begin) {
-		size_t diff = begin - effect_text->array;
-		char *end = strstr(begin, "#endif");
-		if (!end)
-			return;
-		char *el = strstr(begin, "#else");
-		char *eli = strstr(begin, "#elif");
-		if (eli && eli < end && (!el || eli < el)) {
-			//replace #elif with #if
-			dstr_remove(effect_text, diff, el - begin + 5);
-			dstr_insert(effect_text, diff, "#if");
-			begin = strstr(effect_text->array + diff + 3, "#if 0");
-		} else if (el && el < end) {
-			dstr_remove(effect_text, end - effect_text->array,
-				    6); // #endif
-			dstr_remove(effect_text, diff, el - begin + 5);
-			begin = strstr(effect_text->array + diff, "#if 0");
-		} else if (!el || el > end) {
-			dstr_remove(effect_text, diff, end - begin + 6);
-			begin = strstr(effect_text->array + diff, "#if 0");
-		} else {
-			begin = strstr(effect_text->array + diff + 5, "#if 0");
-		}
-	}
-}
-
-static void convert_if1(struct dstr *effect_text)
-{
-	char *begin = strstr(effect_text->array, "#if 1");
-	while (begin) {
-		size_t diff = begin - effect_text->array;
-		char *end = strstr(begin, "#endif");
-		if (!end)
-			return;
-		char *el = strstr(begin, "#el");
-		if (el && el < end) {
-			dstr_remove(effect_text, el - effect_text->array,
-				    end - el + 6); // #endif
-			end = strstr(effect_text->array + diff, "\n");
-			if (end)
-				dstr_remove(effect_text, diff, end - (effect_text->array + diff));
-			begin = strstr(effect_text->array + diff, "#if 1");
-		} else if (!el || el > end) {
-			dstr_remove(effect_text, end - effect_text->array, 6);
-			end = strstr(effect_text->array + diff, "\n");
-			if (end)
-				dstr_remove(effect_text, diff, end - (effect_text->array + diff));
-			begin = strstr(effect_text->array + diff, "#if 1");
-		} else {
-			begin = strstr(effect_text->array + diff + 5, "#if 1");
-		}
-	}
-}
-
-static void convert_return(struct dstr *effect_text, struct dstr *var_name, size_t main_diff)
-{
-	size_t count = 0;
-	char *pos = strstr(effect_text->array + main_diff, var_name->array);
-	while (pos) {
-		if ((pos > effect_text->array && is_var_char(*(pos - 1))) ||
-		    (pos > effect_text->array + 1 && *(pos - 1) == '/' && *(pos - 2) == '/')) {
-			pos = strstr(pos + var_name->len, var_name->array);
-			continue;
-		}
-		size_t diff = pos - effect_text->array;
-		char *ch = pos + var_name->len;
-		if (*ch == '.') {
-			ch++;
-			while (is_var_char(*ch))
-				ch++;
-		}
-		while (*ch == ' ' || *ch == '\t')
-			ch++;
-
-		if (*ch == '=' || (*(ch + 1) == '=' && (*ch == '*' || *ch == '/' || *ch == '+' || *ch == '-'))) {
-			char *bpos = pos - 1;
-			while (bpos > effect_text->array && *bpos != '\n' &&
-			       (*bpos != '/' || *(bpos + 1) != '/'))
-				bpos--;
-			if (*bpos == '/' && *(bpos + 1) == '/') {
-				//comment line
-			} else {
-				count++;
-			}
-		}
-
-		pos = strstr(effect_text->array + diff + var_name->len, var_name->array);
-	}
-	if (count == 0)
-		return;
-	if (count == 1) {
-		pos = strstr(effect_text->array + main_diff, var_name->array);
-		while (pos) {
-			if (pos > effect_text->array && is_var_char(*(pos - 1))) {
-				pos = strstr(pos + var_name->len, var_name->array);
-				continue;
-			}
-			char *bpos = pos - 1;
-			while (bpos > effect_text->array && *bpos != '\n' &&
-			       (*bpos != '/' || *(bpos + 1) != '/'))
-				bpos--;
-			if (*bpos == '/' && *(bpos + 1) == '/') {
-				pos = strstr(pos + var_name->len, var_name->array);
-				continue;
-			}
-
-			size_t diff = pos - effect_text->array;
-			char *ch = pos + var_name->len;
-			bool contains_alpha = true;
-			if (*ch == '.') {
-				contains_alpha = false;
-				ch++;
-				while (is_var_char(*ch)) {
-					if (*ch == 'a' || *ch == 'A' || *ch == 'w' || *ch == 'W')
-						contains_alpha = true;
-					ch++;
-				}
-			}
-
-			while (*ch == ' ' || *ch == '\t')
-				ch++;
-
-			if (*ch == '=') {
-				dstr_remove(effect_text, diff, ch - pos + 1);
-				if (!contains_alpha) {
-					dstr_insert(effect_text, diff, "return float4(");
-					while (diff < effect_text->len && effect_text->array[diff] != ';')
-						diff++;
-					dstr_insert(effect_text, diff, ",1.0)");
-				} else {
-					dstr_insert(effect_text, diff, "return ");
-				}
-				return;
-			} else if (*(ch + 1) == '=' && (*ch == '*' || *ch == '/' || *ch == '+' || *ch == '-')) {
-				dstr_remove(effect_text, diff, ch - pos + 2);
-				if (!contains_alpha) {
-					dstr_insert(effect_text, diff, "return float4(");
-					while (diff < effect_text->len && effect_text->array[diff] != ';')
-						diff++;
-					dstr_insert(effect_text, diff, ",1.0)");
-				} else {
-					dstr_insert(effect_text, diff, "return ");
-				}
-				return;
-			}
-
-			pos = strstr(effect_text->array + diff + var_name->len, var_name->array);
-		}
-		return;
-	}
-
-	size_t replaced = 0;
-	size_t start_diff = 0;
-	bool declared = false;
-	pos = strstr(effect_text->array + main_diff, "{");
-	if (pos) {
-		size_t insert_diff = pos - effect_text->array + 1;
-		dstr_insert(effect_text, insert_diff, " = float4(0.0,0.0,0.0,1.0);\n");
-		dstr_insert(effect_text, insert_diff, var_name->array);
-		dstr_insert(effect_text, insert_diff, "\n\tfloat4 ");
-		declared = true;
-		start_diff = insert_diff - main_diff + 37 + var_name->len;
-	}
-
-	pos = strstr(effect_text->array + main_diff + start_diff, var_name->array);
-	while (pos) {
-		size_t diff = pos - effect_text->array;
-		char *ch = pos + var_name->len;
-		bool part = false;
-		if (*ch == '.') {
-			part = true;
-			ch++;
-			while (is_var_char(*ch))
-				ch++;
-		}
-		while (*ch == ' ' || *ch == '\t')
-			ch++;
-
-		if (*ch == '=') {
-			replaced++;
-			if (replaced == 1 && !declared) {
-				if (part) {
-					dstr_insert(effect_text, diff, " = float4(0.0,0.0,0.0,1.0);\n");
-					dstr_insert(effect_text, diff, var_name->array);
-					dstr_insert(effect_text, diff, "float4 ");
-					diff += 35 + var_name->len;
-				} else {
-					dstr_insert(effect_text, diff, "float4 ");
-					diff += 7;
-				}
-			} else if (replaced == count) {
-				if (part) {
-					while (*ch != ';' && *ch != 0)
-						ch++;
-					diff = ch - effect_text->array + 1;
-					dstr_insert(effect_text, diff, ";");
-					dstr_insert(effect_text, diff, var_name->array);
-					dstr_insert(effect_text, diff, "\n\treturn ");
-				} else {
-					dstr_remove(effect_text, diff, ch - pos + 1);
-					dstr_insert(effect_text, diff, "return ");
-				}
-				return;
-			}
-		} else if (*(ch + 1) == '=' && (*ch == '*' || *ch == '/' || *ch == '+' || *ch == '-')) {
-			replaced++;
-			if (replaced == 1 && !declared) {
-				dstr_insert(effect_text, diff, " = float4(0.0,0.0,0.0,1.0);\n");
-				dstr_insert(effect_text, diff, var_name->array);
-				dstr_insert(effect_text, diff, "float4 ");
-				diff += 35 + var_name->len;
-			} else if (replaced == count) {
-				while (*ch != ';' && *ch != 0)
-					ch++;
-				diff = ch - effect_text->array + 1;
-				dstr_insert(effect_text, diff, ";");
-				dstr_insert(effect_text, diff, var_name->array);
-				dstr_insert(effect_text, diff, "\n\treturn ");
-				return;
-			}
-		}
-
-		pos = strstr(effect_text->array + diff + var_name->len, var_name->array);
-	}
-}
-
 static bool shader_filter_convert(obs_properties_t *props, obs_property_t *property, void *data)
 {
 	UNUSED_PARAMETER(props);
 	if (!data)
-		return false;
-	struct shader_filter_data *filter = data;
-	obs_data_t *settings = obs_source_get_settings(filter->context);
-	if (!settings)
-		return false;
-	struct dstr effect_text = {0};
-	dstr_init_copy(&effect_text, obs_data_get_string(settings, "shader_text"));
-
-	//convert_define is disabled because it removes function-like macro
-	//definitions but leaves their call sites intact, producing broken HLSL.
-	//Re-enable only after implementing call-site substitution.
-	//convert_define(&effect_text);
-
-	size_t start_diff = 24;
-	bool main_no_args = false;
-	int uv = 0;
-	char *main_pos = strstr(effect_text.array, "void mainImage(out vec4");
-	if (!main_pos) {
-		main_pos = strstr(effect_text.array, "void mainImage( out vec4");
-		start_diff++;
-	}
-	if (!main_pos) {
-		main_pos = strstr(effect_text.array, "void main()");
-		if (main_pos)
-			main_no_args = true;
-	}
-	if (!main_pos) {
-		main_pos = strstr(effect_text.array, "vec4 effect(vec4");
-		start_diff = 17;
-		uv = 1;
-	}
-
-	if (!main_pos) {
-		dstr_free(&effect_text);
-		obs_data_release(settings);
-		return false;
-	}
-	size_t main_diff = main_pos - effect_text.array;
-	struct dstr return_color_name = {0};
-	struct dstr coord_name = {0};
-	if (main_no_args) {
-
-		dstr_replace(&effect_text, "void main()", "float4 mainImage(VertData v_in) : TARGET");
-		if (strstr(effect_text.array, "varying vec2 position;")) {
-			uv = 1;
-			dstr_init_copy(&coord_name, "position");
-		} else if (strstr(effect_text.array, "varying vec2 pos;")) {
-			uv = 1;
-			dstr_init_copy(&coord_name, "pos");
-		} else if (strstr(effect_text.array, "fNormal")) {
-			uv = 2;
-			dstr_init_copy(&coord_name, "fNormal");
-		} else {
-			uv = 0;
-			dstr_init_copy(&coord_name, "gl_FragCoord");
-		}
-
-		char *out_start = strstr(effect_text.array, "out vec4");
-		if (out_start) {
-			char *start = out_start + 9;
-			while (*start == ' ' || *start == '\t')
-				start++;
-			char *end = start;
-			while (*end != ' ' && *end != '\t' && *end != '\n' && *end != ',' && *end != '(' && *end != ')' &&
-			       *end != ';' && *end != 0)
-				end++;
-			dstr_ncat(&return_color_name, start, end - start);
-			while (*end == ' ' || *end == '\t')
-				end++;
-			if (*end == ';')
-				dstr_remove(&effect_text, out_start - effect_text.array, (end + 1) - out_start);
-		} else {
-			dstr_init_copy(&return_color_name, "gl_FragColor");
-		}
-	} else {
-
-		char *start = main_pos + start_diff;
-		while (*start == ' ' || *start == '\t')
-			start++;
-		char *end = start;
-		while (*end != ' ' && *end != '\t' && *end != '\n' && *end != ',' && *end != ')' && *end != 0)
-			end++;
-
-		dstr_ncat(&return_color_name, start, end - start);
-
-		start = strstr(end, ",");
-		if (!start) {
-			dstr_free(&effect_text);
-			dstr_free(&return_color_name);
-			obs_data_release(settings);
-			return false;
-		}
-		start++;
-		while (*start == ' ' || *start == '\t')
-			start++;
-		char *v2i = strstr(start, "in vec2 ");
-		char *v2 = strstr(start, "vec2 ");
-		char *close = strstr(start, ")");
-		if (v2i && close && v2i < close) {
-			start = v2i + 8;
-		} else if (v2 && close && v2 < close) {
-			start = v2 + 5;
-		} else {
-			if (*start == 'i' && *(start + 1) == 'n' && (*(start + 2) == ' ' || *(start + 2) == '\t'))
-				start += 3;
-			while (*start == ' ' || *start == '\t')
-				start++;
-			if (*start == 'v' && *(start + 1) == 'e' && *(start + 2) == 'c' && *(start + 3) == '2' &&
-			    (*(start + 4) == ' ' || *(start + 4) == '\t'))
-				start += 5;
-		}
-		while (*start == ' ' || *start == '\t')
-			start++;
-
-		end = start;
-		while (*end != ' ' && *end != '\t' && *end != '\n' && *end != ',' && *end != ')' && *end != 0)
-			end++;
-
-		dstr_ncat(&coord_name, start, end - start);
-
-		while (*end != ')' && *end != 0)
-			end++;
-		size_t idx = main_pos - effect_text.array;
-		dstr_remove(&effect_text, idx, end - main_pos + 1);
-		dstr_insert(&effect_text, idx, "float4 mainImage(VertData v_in) : TARGET");
-	}
-
-	convert_return(&effect_text, &return_color_name, main_diff);
-
-	dstr_free(&return_color_name);
-
-	if (dstr_cmp(&coord_name, "fragCoord") != 0) {
-		if (dstr_find(&coord_name, "fragCoord")) {
-			dstr_replace(&effect_text, coord_name.array, "fragCoord");
-		} else {
-			char *pos = strstr(effect_text.array, coord_name.array);
-			while (pos) {
-				size_t diff = pos - effect_text.array;
-				if (((main_no_args || diff < main_diff) || diff > main_diff + 24) &&
-				    (pos == effect_text.array || !is_var_char(*(pos - 1))) &&
-				    !is_var_char(*(pos + coord_name.len))) {
-					dstr_remove(&effect_text, diff, coord_name.len);
-					dstr_insert(&effect_text, diff, "fragCoord");
-					pos = strstr(effect_text.array + diff + 9, coord_name.array);
-
-				} else {
-					pos = strstr(effect_text.array + diff + coord_name.len, coord_name.array);
-				}
-			}
-		}
-	}
-	dstr_free(&coord_name);
-
-	convert_if0(&effect_text);
-	convert_if1(&effect_text);
-
-	dstr_replace(&effect_text, "varying vec3", "//varying vec3");
-	dstr_replace(&effect_text, "precision highp float;", "//precision highp float;");
-	if (uv == 1) {
-		dstr_replace(&effect_text, "fragCoord", "v_in.uv");
-	} else if (uv == 2) {
-		dstr_replace(&effect_text, "fragCoord.xy", "v_in.uv");
-		dstr_replace(&effect_text, "fragCoord", "float3(v_in.uv,0.0)");
-	} else {
-		dstr_replace(&effect_text, "fragCoord.xy/iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "fragCoord.xy / iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "fragCoord/iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "fragCoord / iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "fragCoord", "(v_in.uv * uv_size)");
-		dstr_replace(&effect_text, "gl_FragCoord.xy/iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "gl_FragCoord.xy / iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "gl_FragCoord/iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "gl_FragCoord / iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "gl_FragCoord", "(v_in.uv * uv_size)");
-	}
-	dstr_replace(&effect_text, "love_ScreenSize", "uv_size");
-	dstr_replace(&effect_text, "u_resolution", "uv_size");
-	dstr_replace(&effect_text, "uResolution", "uv_size");
-	dstr_replace(&effect_text, "iResolution.xyz", "float3(uv_size,0.0)");
-	dstr_replace(&effect_text, "iResolution.xy", "uv_size");
-	dstr_replace(&effect_text, "iResolution.x", "uv_size.x");
-	dstr_replace(&effect_text, "iResolution.y", "uv_size.y");
-	dstr_replace(&effect_text, "iResolution", "float4(uv_size,uv_pixel_interval)");
-
-	dstr_replace(&effect_text, "uniform vec2 uv_size;", "");
-
-	if (strstr(effect_text.array, "iTime"))
-		dstr_replace(&effect_text, "iTime", "elapsed_time");
-	else if (strstr(effect_text.array, "uTime"))
-		dstr_replace(&effect_text, "uTime", "elapsed_time");
-	else if (strstr(effect_text.array, "u_time"))
-		dstr_replace(&effect_text, "u_time", "elapsed_time");
-	else
-		dstr_replace(&effect_text, "time", "elapsed_time");
-
-	dstr_replace(&effect_text, "uniform float elapsed_time;", "");
-
-	dstr_replace(&effect_text, "iDate.w", "local_time");
-
-	dstr_replace(&effect_text, "bvec2", "bool2");
-	dstr_replace(&effect_text, "bvec3", "bool3");
-	dstr_replace(&effect_text, "bvec4", "bool4");
-
-	dstr_replace(&effect_text, "ivec4", "int4");
-	dstr_replace(&effect_text, "ivec3", "int3");
-	dstr_replace(&effect_text, "ivec2", "int2");
-
-	dstr_replace(&effect_text, "uvec4", "uint4");
-	dstr_replace(&effect_text, "uvec3", "uint3");
-	dstr_replace(&effect_text, "uvec2", "uint2");
-
-	dstr_replace(&effect_text, "vec4", "float4");
-	dstr_replace(&effect_text, "vec3", "float3");
-	dstr_replace(&effect_text, "vec2", "float2");
-
-	dstr_replace(&effect_text, " number ", " float ");
-
-	//dstr_replace(&effect_text, "mat4", "float4x4");
-	//dstr_replace(&effect_text, "mat3", "float3x3");
-	//dstr_replace(&effect_text, "mat2", "float2x2");
-
-	dstr_replace(&effect_text, "dFdx(", "ddx(");
-	dstr_replace(&effect_text, "dFdy(", "ddy(");
-	dstr_replace(&effect_text, "mix(", "lerp(");
-	dstr_replace(&effect_text, "fract(", "frac(");
-	dstr_replace(&effect_text, "inversesqrt(", "rsqrt(");
-
-	dstr_replace(&effect_text, "extern bool", "uniform bool");
-	dstr_replace(&effect_text, "extern uint", "uniform uint");
-	dstr_replace(&effect_text, "extern int", "uniform int");
-	dstr_replace(&effect_text, "extern float", "uniform float");
-
-	convert_init(&effect_text, "bool");
-	convert_init(&effect_text, "uint");
-	convert_init(&effect_text, "int");
-	convert_init(&effect_text, "float");
-
-	convert_vector_init(&effect_text, "bool(", 1);
-	convert_vector_init(&effect_text, "bool2(", 2);
-	convert_vector_init(&effect_text, "bool3(", 3);
-	convert_vector_init(&effect_text, "bool4(", 4);
-	convert_vector_init(&effect_text, "uint(", 1);
-	convert_vector_init(&effect_text, "uint2(", 2);
-	convert_vector_init(&effect_text, "uint3(", 3);
-	convert_vector_init(&effect_text, "uint4(", 4);
-	convert_vector_init(&effect_text, "int(", 1);
-	convert_vector_init(&effect_text, "int2(", 2);
-	convert_vector_init(&effect_text, "int3(", 3);
-	convert_vector_init(&effect_text, "int4(", 4);
-	convert_vector_init(&effect_text, "float(", 1);
-	convert_vector_init(&effect_text, "float2(", 2);
-	convert_vector_init(&effect_text, "float3(", 3);
-	convert_vector_init(&effect_text, "float4(", 4);
-	convert_vector_init(&effect_text, "mat2(", 4);
-	convert_vector_init(&effect_text, "mat3(", 9);
-	convert_vector_init(&effect_text, "mat4(", 16);
-
-	convert_atan(&effect_text);
-	convert_mat_mul(&effect_text, "mat2");
-	convert_mat_mul(&effect_text, "mat3");
-	convert_mat_mul(&effect_text, "mat4");
-
-	dstr_replace(&effect_text, "point(", "point2(");
-	dstr_replace(&effect_text, "line(", "line2(");
-
-	dstr_replace(&effect_text, "#version ", "//#version ");
-
-	convert_if_defined(&effect_text);
-
-	dstr_replace(&effect_text, "acos(-1.0)", "3.14159265359");
-	dstr_replace(&effect_text, "acos(-1.)", "3.14159265359");
-	dstr_replace(&effect_text, "acos(-1)", "3.14159265359");
-
-	struct dstr insert_text = {0};
-	dstr_init_copy(&insert_text, "#ifndef OPENGL\n");
-
-	if (dstr_find(&effect_text, "mat2"))
-		dstr_cat(&insert_text, "#define mat2 float2x2\n");
-	if (dstr_find(&effect_text, "mat3"))
-		dstr_cat(&insert_text, "#define mat3 float3x3\n");
-	if (dstr_find(&effect_text, "mat4"))
-		dstr_cat(&insert_text, "#define mat4 float4x4\n");
-
-	if (dstr_find(&effect_text, "mod("))
-		dstr_cat(&insert_text, "#define mod(x,y) ((x) - (y) * floor((x) / (y)))\n");
-	if (dstr_find(&effect_text, "lessThan("))
-		dstr_cat(&insert_text, "#define lessThan(a,b) ((a) < (b))\n");
-	if (dstr_find(&effect_text, "greaterThan("))
-		dstr_cat(&insert_text, "#define greaterThan(a,b) ((a) > (b))\n");
-	dstr_cat(&insert_text, "#endif\n");
-
-	if (dstr_find(&effect_text, "iMouse") && !dstr_find(&effect_text, "float2 iMouse"))
-		dstr_cat(
-			&insert_text,
-			"uniform float4 iMouse<\nstring widget_type = \"slider\";\nfloat minimum=0.0;\nfloat maximum=1000.0;\nfloat step=1.0;\n>;\n");
-
-	if (dstr_find(&effect_text, "iFrame") && !dstr_find(&effect_text, "float iFrame"))
-		dstr_cat(&insert_text, "uniform float iFrame;\n");
-
-	if (dstr_find(&effect_text, "iSampleRate") && !dstr_find(&effect_text, "float iSampleRate"))
-		dstr_cat(&insert_text, "uniform float iSampleRate;\n");
-
-	if (dstr_find(&effect_text, "iTimeDelta") && !dstr_find(&effect_text, "float iTimeDelta"))
-		dstr_cat(&insert_text, "uniform float iTimeDelta;\n");
-
-	int num_textures = 0;
-	struct dstr texture_name = {0};
-	struct dstr replacing = {0};
-	struct dstr replacement = {0};
-
-	char *texture_find[] = {"texture(", "texture2D(", "texelFetch(", "Texel(", "textureLod("};
-	char *texture = NULL;
-	size_t texture_diff = 0;
-	for (size_t i = 0; i < sizeof(texture_find) / sizeof(char *); i++) {
-		char *t = strstr(effect_text.array, texture_find[i]);
-		if (t && (!texture || t < texture)) {
-			texture = t;
-			texture_diff = strlen(texture_find[i]);
-		}
-	}
-	while (texture) {
-		const size_t diff = texture - effect_text.array;
-		if (is_var_char(*(texture - 1))) {
-			texture = NULL;
-			size_t prev_diff = texture_diff;
-			for (size_t i = 0; i < 3; i++) {
-				char *t = strstr(effect_text.array + diff + prev_diff, texture_find[i]);
-				if (t && (!texture || t < texture)) {
-					texture = t;
-					texture_diff = strlen(texture_find[i]);
-				}
-			}
-			continue;
-		}
-		char *start = texture + texture_diff;
-		while (*start == ' ' || *start == '\t')
-			start++;
-		char *end = start;
-		while (*end != ' ' && *end != '\t' && *end != ',' && *end != ')' && *end != '\n' && *end != 0)
-			end++;
-		dstr_copy(&texture_name, "");
-		dstr_ncat(&texture_name, start, end - start);
-
-		dstr_copy(&replacing, "");
-		dstr_ncat(&replacing, texture, end - texture);
-
-		dstr_copy(&replacement, "");
-
-		if (num_textures) {
-			dstr_cat_dstr(&replacement, &texture_name);
-			dstr_cat(&replacement, ".Sample(textureSampler");
-
-			dstr_cat(&insert_text, "uniform texture2d ");
-			dstr_cat(&insert_text, texture_name.array);
-			dstr_cat(&insert_text, ";\n");
-		} else {
-			dstr_cat(&replacement, "image.Sample(textureSampler");
-		}
-		dstr_replace(&effect_text, replacing.array, replacement.array);
-
-		dstr_copy(&replacing, "textureSize(");
-		dstr_cat(&replacing, texture_name.array);
-		dstr_cat(&replacing, ", 0)");
-
-		dstr_replace(&effect_text, replacing.array, "uv_size");
-		dstr_replace(&replacing, ", 0)", ",0)");
-		dstr_replace(&effect_text, replacing.array, "uv_size");
-
-		num_textures++;
-		size_t prev_diff = texture_diff;
-		texture = NULL;
-		for (size_t i = 0; i < sizeof(texture_find) / sizeof(char *); i++) {
-			char *t = strstr(effect_text.array + diff + prev_diff, texture_find[i]);
-			if (t && (!texture || t < texture)) {
-				texture = t;
-				texture_diff = strlen(texture_find[i]);
-			}
-		}
-	}
-	dstr_free(&replacing);
-	dstr_free(&replacement);
-	dstr_free(&texture_name);
+		return false;
+	struct shader_filter_data *filter = data;
+	obs_data_t *settings = obs_source_get_settings(filter->context);
+	if (!settings)
+		return false;
 
-	if (insert_text.len > 24) {
-		dstr_insert_dstr(&effect_text, 0, &insert_text);
+	char *effect_text = shader_convert_glsl(obs_data_get_string(settings, "shader_text"));
+	if (!effect_text) {
+		obs_data_release(settings);
+		return false;
 	}
-	dstr_free(&insert_text);
-
-	obs_data_set_string(settings, "shader_text", effect_text.array);
-
-	dstr_free(&effect_text);
+	obs_data_set_string(settings, "shader_text", effect_text);
+	bfree(effect_text);
 
 	obs_data_release(settings);
 	obs_property_set_visible(property, false);
@@ -2417,12 +2640,19 @@ static obs_properties_t *shader_filter_properties(void *data)
 	obs_properties_add_button2(source_group, "reload_effect", obs_module_text("ShaderFilter.ReloadEffect"),
 				   shader_filter_reload_effect_clicked, data);
 
+	if (filter && !filter->source && !filter->transition) {
+		obs_property_t *stages = obs_properties_add_editable_list(source_group, "shader_stages",
+									  obs_module_text("ShaderFilter.Stages"),
+									  OBS_EDITABLE_LIST_TYPE_FILES, "Shaders (*.shader *.effect)", NULL);
+		obs_property_set_long_description(stages, obs_module_text("ShaderFilter.Stages.Tooltip"));
+	}
+
 	if (filter && filter->source) {
 		obs_properties_add_int(source_group, "source_width", obs_module_text("ShaderFilter.SourceWidth"), 1, 16384, 1);
 		obs_properties_add_int(source_group, "source_height", obs_module_text("ShaderFilter.SourceHeight"), 1, 16384, 1);
 	}
 
-	if (filter && (filter->param_audio_magnitude || filter->param_audio_peak)) {
+	if (filter && (filter->used_builtins & SHADER_BUILTIN_AUDIO_MASK)) {
 		obs_property_t *audio_source = obs_properties_add_list(source_group, "audio_source", "Audio source",
 								       OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
 		obs_property_list_add_string(audio_source, "None", "");
@@ -2677,6 +2907,25 @@ static obs_properties_t *shader_filter_properties(void *data)
 	}
 	da_free(groups);
 
+	if (!filter || !filter->transition) {
+		obs_property_t *render_scale = obs_properties_add_float_slider(props, "render_scale",
+									       obs_module_text("ShaderFilter.RenderScale"), 0.25, 1.0, 0.05);
+		obs_property_set_long_description(render_scale, obs_module_text("ShaderFilter.RenderScale.Tooltip"));
+		obs_property_t *render_upscale = obs_properties_add_list(props, "render_upscale",
+									 obs_module_text("ShaderFilter.RenderUpscale"),
+									 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+		obs_property_list_add_int(render_upscale, obs_module_text("ShaderFilter.RenderUpscale.Bilinear"), 0);
+		obs_property_list_add_int(render_upscale, obs_module_text("ShaderFilter.RenderUpscale.Sharpen"), 1);
+
+		obs_property_t *update_interval = obs_properties_add_int(props, "update_interval",
+									 obs_module_text("ShaderFilter.UpdateInterval"), 1, 60, 1);
+		obs_property_set_long_description(update_interval, obs_module_text("ShaderFilter.UpdateRate.Tooltip"));
+		obs_property_t *update_rate = obs_properties_add_float(props, "update_rate", obs_module_text("ShaderFilter.UpdateRate"),
+								       0.0, 240.0, 0.5);
+		obs_property_float_set_suffix(update_rate, " Hz");
+		obs_property_set_long_description(update_rate, obs_module_text("ShaderFilter.UpdateRate.Tooltip"));
+	}
+
 	if (!filter || (!filter->source && !filter->transition)) {
 		obs_properties_t *expand_group = obs_properties_create();
 		obs_property_t *expand_prop = obs_properties_add_group(props, "expand_group", obs_module_text("ShaderFilter.ExpandPixels"),
@@ -2705,6 +2954,277 @@ static obs_properties_t *shader_filter_properties(void *data)
 	return props;
 }
 
+/* Returns the offset just past the ';' ending the declaration of uniform name. */
+static size_t find_uniform_declaration_end(const char *text, const char *name)
+{
+	const size_t name_len = strlen(name);
+	for (const char *pos = strstr(text, "uniform"); pos; pos = strstr(pos + 7, "uniform")) {
+		if ((pos > text && is_var_char(pos[-1])) || is_var_char(pos[7]))
+			continue;
+		const char *cur = pos + 7;
+		while (*cur == ' ' || *cur == '\t' || *cur == '\r' || *cur == '\n')
+			cur++;
+		const char *type = cur;
+		while (is_var_char(*cur))
+			cur++;
+		if (cur == type)
+			continue;
+		while (*cur == ' ' || *cur == '\t' || *cur == '\r' || *cur == '\n')
+			cur++;
+		if (strncmp(cur, name, name_len) != 0 || is_var_char(cur[name_len]))
+			continue;
+
+		// Skip the annotations and default value, they can contain ';' inside '<>' and strings.
+		bool in_string = false;
+		int depth = 0;
+		for (cur += name_len; *cur; cur++) {
+			if (*cur == '"')
+				in_string = !in_string;
+			else if (in_string)
+				continue;
+			else if (*cur == '<')
+				depth++;
+			else if (*cur == '>')
+				depth--;
+			else if (*cur == ';' && depth <= 0)
+				return cur + 1 - text;
+		}
+		break;
+	}
+	return SIZE_MAX;
+}
+
+static const char *specialized_value(const struct effect_param_binding *binding, char *buf, size_t size)
+{
+	if (binding->type == GS_SHADER_PARAM_BOOL)
+		return binding->value.i ? "true" : "false";
+	snprintf(buf, size, "%lld", binding->value.i);
+	return buf;
+}
+
+/* Builds the text of a permutation on the compile queue, the effect is created on the next tick. */
+static void shader_variant_job_run(void *data)
+{
+	struct shader_compile_job *job = data;
+	struct dstr text = {0};
+	struct dstr define = {0};
+	dstr_copy(&text, job->source);
+	for (size_t i = 0; i < job->defines.num; i++) {
+		const struct shader_define *def = job->defines.array + i;
+		size_t offset = find_uniform_declaration_end(text.array, def->name);
+		if (offset == SIZE_MAX) {
+			blog(LOG_WARNING, "[obs-shaderfilter] could not find the declaration of specialized param '%s'",
+			     def->name);
+			continue;
+		}
+		// Defined after the declaration so the uniform itself stays visible to the effect.
+		dstr_printf(&define, "\n#define %s %s\n", def->name, def->value);
+		dstr_insert(&text, offset, define.array);
+	}
+	dstr_free(&define);
+	job->effect_text = text.array;
+	job->status = SHADER_COMPILE_OK;
+
+	os_atomic_store_bool(&job->done, true);
+	shader_compile_job_release(job);
+}
+
+static void shader_filter_queue_variant(struct shader_filter_data *filter)
+{
+	// The job for this permutation is already on its way.
+	if (filter->variant_job && strcmp(filter->variant_job->variant_key, filter->variant_key.array) == 0)
+		return;
+
+	char buf[32];
+	struct shader_compile_job *job = bzalloc(sizeof(struct shader_compile_job));
+	job->refs = 2;
+	job->source = bstrdup(filter->effect_text);
+	job->variant_key = bstrdup(filter->variant_key.array);
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		struct effect_param_data *param = filter->stored_param_list.array + i;
+		if (!param->specialize)
+			continue;
+		struct shader_define *def = da_push_back_new(job->defines);
+		def->name = bstrdup(param->name.array);
+		def->value = bstrdup(specialized_value(filter->param_bindings.array + i, buf, sizeof(buf)));
+	}
+
+	// Only the latest permutation is built, one the user already moved past is not.
+	shader_compile_job_release(filter->variant_job);
+	filter->variant_job = job;
+
+	if (!shader_compile_queue || !os_task_queue_queue_task(shader_compile_queue, shader_variant_job_run, job))
+		shader_variant_job_run(job);
+}
+
+/* Points the builtin and user param handles at the matching params of effect. */
+static void shader_filter_bind_effect(struct shader_filter_data *filter, gs_effect_t *effect)
+{
+	filter->effect = effect;
+	memset(filter->builtin_params, 0, sizeof(filter->builtin_params));
+	memset(filter->input_mip_params, 0, sizeof(filter->input_mip_params));
+	filter->used_builtins = 0;
+	if (!effect)
+		return;
+	size_t effect_count = gs_effect_get_num_params(effect);
+	for (size_t effect_index = 0; effect_index < effect_count; effect_index++) {
+		gs_eparam_t *param = gs_effect_get_param_by_idx(effect, effect_index);
+		struct gs_effect_param_info info;
+		gs_effect_get_param_info(param, &info);
+		if (!shader_filter_bind_input_mip(filter, info.name, param))
+			shader_filter_bind_builtin_param(filter, info.name, param);
+	}
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		struct effect_param_data *param = filter->stored_param_list.array + i;
+		filter->param_bindings.array[i].param = gs_effect_get_param_by_name(effect, param->name.array);
+	}
+	for (size_t i = 0; i < filter->pass_targets.num; i++) {
+		struct shader_pass_target *target = filter->pass_targets.array + i;
+		target->param = gs_effect_get_param_by_name(effect, target->name);
+	}
+}
+
+static void shader_filter_select_variant(struct shader_filter_data *filter)
+{
+	if (!filter->base_effect || !filter->effect_text)
+		return;
+
+	char buf[32];
+	// Keep the buffer, dstr_copy() of an empty string would free it.
+	if (filter->variant_key.array) {
+		filter->variant_key.array[0] = '\0';
+		filter->variant_key.len = 0;
+	}
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		struct effect_param_data *param = filter->stored_param_list.array + i;
+		if (param->specialize) {
+			dstr_cat(&filter->variant_key, specialized_value(filter->param_bindings.array + i, buf, sizeof(buf)));
+			dstr_cat_ch(&filter->variant_key, ',');
+		}
+	}
+
+	struct shader_variant *variant = NULL;
+	for (size_t i = 0; i < filter->num_variants; i++) {
+		if (strcmp(filter->variants[i].key, filter->variant_key.array) == 0) {
+			variant = &filter->variants[i];
+			break;
+		}
+	}
+
+	gs_effect_t *effect = filter->base_effect;
+	if (variant) {
+		variant->last_used = ++filter->variant_clock;
+		if (variant->effect)
+			effect = variant->effect;
+	} else {
+		// The base effect reads the params as uniforms and renders this permutation until it is built.
+		shader_filter_queue_variant(filter);
+	}
+	if (effect != filter->effect)
+		shader_filter_bind_effect(filter, effect);
+}
+
+/* Creates the effect of a permutation built on the compile queue and switches to it if it is still current. */
+static void shader_filter_finish_variant(struct shader_filter_data *filter)
+{
+	struct shader_compile_job *job = filter->variant_job;
+	if (!job || !os_atomic_load_bool(&job->done))
+		return;
+	filter->variant_job = NULL;
+
+	struct shader_variant *variant;
+	if (filter->num_variants < SHADER_VARIANT_CACHE_SIZE) {
+		variant = &filter->variants[filter->num_variants++];
+	} else {
+		variant = &filter->variants[0];
+		for (size_t i = 1; i < filter->num_variants; i++) {
+			if (filter->variants[i].last_used < variant->last_used)
+				variant = &filter->variants[i];
+		}
+		if (variant->effect == filter->effect)
+			shader_filter_bind_effect(filter, filter->base_effect);
+		obs_enter_graphics();
+		shared_effect_release(variant->effect);
+		obs_leave_graphics();
+		bfree(variant->key);
+	}
+
+	char *errors = NULL;
+	obs_enter_graphics();
+	variant->effect = shared_effect_acquire(job->effect_text, &errors);
+	obs_leave_graphics();
+	// A failed permutation is cached too, the base effect still renders it correctly.
+	if (!variant->effect)
+		blog(LOG_WARNING, "[obs-shaderfilter] Unable to create specialized effect. Errors returned from parser:\n%s",
+		     (errors == NULL || strlen(errors) == 0 ? "(None)" : errors));
+	bfree(errors);
+	variant->key = job->variant_key;
+	job->variant_key = NULL;
+	variant->last_used = ++filter->variant_clock;
+
+	if (variant->effect && variant->effect != filter->effect && strcmp(variant->key, filter->variant_key.array) == 0) {
+		shader_filter_bind_effect(filter, variant->effect);
+		filter->update_forced = true;
+		filter->content_hash = 0;
+	}
+	shader_compile_job_release(job);
+}
+
+/* libobs drops the values set on an effect when its technique ends and uploads each parameter's
+ * default on the next draw, so a value equal to that default does not have to be set at all. */
+static bool shader_param_is_default(const struct effect_param_binding *binding, const void *default_value)
+{
+	if (!default_value)
+		return false;
+
+	switch (binding->type) {
+	case GS_SHADER_PARAM_BOOL:
+		return *(const bool *)default_value == (binding->value.i != 0);
+	case GS_SHADER_PARAM_FLOAT: {
+		float f = (float)binding->value.f;
+		return memcmp(&f, default_value, sizeof(f)) == 0;
+	}
+	case GS_SHADER_PARAM_INT: {
+		int i = (int)binding->value.i;
+		return memcmp(&i, default_value, sizeof(i)) == 0;
+	}
+	case GS_SHADER_PARAM_VEC2:
+		return memcmp(binding->value.vec2.ptr, default_value, sizeof(float) * 2) == 0;
+	case GS_SHADER_PARAM_VEC3:
+		return memcmp(binding->value.vec3.ptr, default_value, sizeof(float) * 3) == 0;
+	case GS_SHADER_PARAM_VEC4:
+		return memcmp(binding->value.vec4.ptr, default_value, sizeof(float) * 4) == 0;
+	default:
+		return false;
+	}
+}
+
+/* Matches the stages to the "shader_stages" file list, stages whose file did not change are kept. */
+static void shader_filter_update_stages(struct shader_filter_data *filter, obs_data_t *settings)
+{
+	obs_data_array_t *files = obs_data_get_array(settings, "shader_stages");
+	size_t count = obs_data_array_count(files);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(files, i);
+		const char *file_name = obs_data_get_string(item, "value");
+		if (i == filter->stages.num) {
+			struct shader_filter_data *stage = shader_filter_create_stage(filter, file_name);
+			da_push_back(filter->stages, &stage);
+		} else if (strcmp(filter->stages.array[i]->last_path.array ? filter->stages.array[i]->last_path.array : "",
+				  file_name) != 0) {
+			shader_filter_destroy(filter->stages.array[i]);
+			filter->stages.array[i] = shader_filter_create_stage(filter, file_name);
+		}
+		obs_data_release(item);
+	}
+	obs_data_array_release(files);
+
+	while (filter->stages.num > count)
+		shader_filter_destroy(filter->stages.array[--filter->stages.num]);
+	// The stage that drew it may be gone, the next frame draws the stages again.
+	filter->stage_output = NULL;
+}
+
 static void shader_filter_update(void *data, obs_data_t *settings)
 {
 	struct shader_filter_data *filter = data;
@@ -2715,6 +3235,26 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 	filter->expand_right = (int)obs_data_get_int(settings, "expand_right");
 	filter->expand_top = (int)obs_data_get_int(settings, "expand_top");
 	filter->expand_bottom = (int)obs_data_get_int(settings, "expand_bottom");
+	// Stages are drawn at the size their parent renders at.
+	if (filter->transition || filter->stage_settings) {
+		filter->render_scale = 1.0f;
+		filter->render_sharpen = false;
+	} else {
+		filter->render_scale = (float)obs_data_get_double(settings, "render_scale");
+		filter->render_scale = filter->render_scale < 0.25f ? 0.25f : filter->render_scale > 1.0f ? 1.0f : filter->render_scale;
+		filter->render_sharpen = obs_data_get_int(settings, "render_upscale") == 1;
+	}
+	if (!filter->transition && !filter->stage_settings) {
+		filter->update_interval = (int)obs_data_get_int(settings, "update_interval");
+		filter->update_rate = (float)obs_data_get_double(settings, "update_rate");
+		// Spread instances over the period by the golden ratio of their phase.
+		if (filter->update_rate > 0.0f) {
+			const double phase = (double)filter->update_phase * 0.6180339887;
+			filter->update_elapsed = (float)(phase - floor(phase)) / filter->update_rate;
+		}
+	}
+	filter->update_forced = true;
+	filter->content_hash = 0;
 	if (filter->source) {
 		filter->width = clamp_source_dimension((int)obs_data_get_int(settings, "source_width"));
 		filter->height = clamp_source_dimension((int)obs_data_get_int(settings, "source_height"));
@@ -2724,12 +3264,12 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 	if (filter->reload_effect) {
 		filter->reload_effect = false;
 		shader_filter_reload_effect(filter);
-		if (!filter->auto_triggered_reload)
-			obs_source_update_properties(filter->context);
-		filter->auto_triggered_reload = false;
 	}
 
-	if (filter->param_audio_magnitude || filter->param_audio_peak) {
+	if (!filter->source && !filter->transition && !filter->stage_settings)
+		shader_filter_update_stages(filter, settings);
+
+	if (filter->used_builtins & SHADER_BUILTIN_AUDIO_MASK) {
 		const char *audio_source_name = obs_data_get_string(settings, "audio_source");
 		if (!filter->audio_source_name || strcmp(filter->audio_source_name, audio_source_name) != 0) {
 			obs_source_t *audio_source = strlen(audio_source_name) > 0 ? obs_get_source_by_name(audio_source_name)
@@ -2783,11 +3323,11 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 	size_t param_count = filter->stored_param_list.num;
 	for (size_t param_index = 0; param_index < param_count; param_index++) {
 		struct effect_param_data *param = (filter->stored_param_list.array + param_index);
+		struct effect_param_binding *binding = (filter->param_bindings.array + param_index);
 		//gs_eparam_t *annot = gs_param_get_annotation_by_idx(param->param, param_index);
 		const char *param_name = param->name.array;
-		struct dstr sources_name = {0};
 		obs_source_t *source = NULL;
-		void *default_value = gs_effect_get_default_val(param->param);
+		const void *default_value = param->effect_default;
 		param->has_default = false;
 		switch (param->type) {
 		case GS_SHADER_PARAM_BOOL:
@@ -2796,7 +3336,7 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 				param->default_value.i = *(bool *)default_value;
 				param->has_default = true;
 			}
-			param->value.i = obs_data_get_bool(settings, param_name);
+			binding->value.i = obs_data_get_bool(settings, param_name);
 			break;
 		case GS_SHADER_PARAM_FLOAT:
 			if (default_value != NULL) {
@@ -2804,7 +3344,7 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 				param->default_value.f = *(float *)default_value;
 				param->has_default = true;
 			}
-			param->value.f = obs_data_get_double(settings, param_name);
+			binding->value.f = obs_data_get_double(settings, param_name);
 			break;
 		case GS_SHADER_PARAM_INT:
 			if (default_value != NULL) {
@@ -2812,36 +3352,34 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 				param->default_value.i = *(int *)default_value;
 				param->has_default = true;
 			}
-			param->value.i = obs_data_get_int(settings, param_name);
+			binding->value.i = obs_data_get_int(settings, param_name);
 			break;
 		case GS_SHADER_PARAM_VEC2: {
-			struct vec2 *xy = default_value;
+			const struct vec2 *xy = default_value;
 
 			for (size_t i = 0; i < 2; i++) {
-				dstr_printf(&sources_name, "%s_%zu", param_name, i);
+				const char *key = param->component_keys[i].array;
 				if (xy != NULL) {
-					obs_data_set_default_double(settings, sources_name.array, xy->ptr[i]);
+					obs_data_set_default_double(settings, key, xy->ptr[i]);
 					param->default_value.vec2.ptr[i] = xy->ptr[i];
 					param->has_default = true;
 				}
-				param->value.vec2.ptr[i] = (float)obs_data_get_double(settings, sources_name.array);
+				binding->value.vec2.ptr[i] = (float)obs_data_get_double(settings, key);
 			}
-			dstr_free(&sources_name);
 			break;
 		}
 		case GS_SHADER_PARAM_VEC3: {
-			struct vec3 *rgb = default_value;
+			const struct vec3 *rgb = default_value;
 			if (param->widget_type.array && strcmp(param->widget_type.array, "slider") == 0) {
 				for (size_t i = 0; i < 3; i++) {
-					dstr_printf(&sources_name, "%s_%zu", param_name, i);
+					const char *key = param->component_keys[i].array;
 					if (rgb != NULL) {
-						obs_data_set_default_double(settings, sources_name.array, rgb->ptr[i]);
+						obs_data_set_default_double(settings, key, rgb->ptr[i]);
 						param->default_value.vec3.ptr[i] = rgb->ptr[i];
 						param->has_default = true;
 					}
-					param->value.vec3.ptr[i] = (float)obs_data_get_double(settings, sources_name.array);
+					binding->value.vec3.ptr[i] = (float)obs_data_get_double(settings, key);
 				}
-				dstr_free(&sources_name);
 			} else {
 				if (rgb != NULL) {
 					struct vec4 rgba;
@@ -2853,23 +3391,22 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 					// Ensure color parameters have a white fallback value.
 					obs_data_set_default_int(settings, param_name, 0xffffffff);
 				}
-				vec4_from_rgba(&param->value.vec4, (uint32_t)obs_data_get_int(settings, param_name));
+				vec4_from_rgba(&binding->value.vec4, (uint32_t)obs_data_get_int(settings, param_name));
 			}
 			break;
 		}
 		case GS_SHADER_PARAM_VEC4: {
-			struct vec4 *rgba = default_value;
+			const struct vec4 *rgba = default_value;
 			if (param->widget_type.array && strcmp(param->widget_type.array, "slider") == 0) {
 				for (size_t i = 0; i < 4; i++) {
-					dstr_printf(&sources_name, "%s_%zu", param_name, i);
+					const char *key = param->component_keys[i].array;
 					if (rgba != NULL) {
-						obs_data_set_default_double(settings, sources_name.array, rgba->ptr[i]);
+						obs_data_set_default_double(settings, key, rgba->ptr[i]);
 						param->default_value.vec4.ptr[i] = rgba->ptr[i];
 						param->has_default = true;
 					}
-					param->value.vec4.ptr[i] = (float)obs_data_get_double(settings, sources_name.array);
+					binding->value.vec4.ptr[i] = (float)obs_data_get_double(settings, key);
 				}
-				dstr_free(&sources_name);
 			} else {
 				if (rgba != NULL) {
 					obs_data_set_default_int(settings, param_name, vec4_to_rgba(rgba));
@@ -2879,15 +3416,12 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 					// Ensure color parameters have a white fallback value.
 					obs_data_set_default_int(settings, param_name, 0xffffffff);
 				}
-				vec4_from_rgba(&param->value.vec4, (uint32_t)obs_data_get_int(settings, param_name));
+				vec4_from_rgba(&binding->value.vec4, (uint32_t)obs_data_get_int(settings, param_name));
 			}
 			break;
 		}
 		case GS_SHADER_PARAM_TEXTURE:
-			dstr_init_copy_dstr(&sources_name, &param->name);
-			dstr_cat(&sources_name, "_source");
-			const char *sn = obs_data_get_string(settings, sources_name.array);
-			dstr_free(&sources_name);
+			const char *sn = obs_data_get_string(settings, param->source_key.array);
 			source = obs_weak_source_get_source(param->source);
 			if (source && strcmp(obs_source_get_name(source), sn) != 0) {
 				obs_source_release(source);
@@ -2924,35 +3458,18 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 				}
 				dstr_free(&param->path);
 			} else {
-				const char *path = default_value;
-				if (!obs_data_has_user_value(settings, param_name) && path && strlen(path)) {
-					if (os_file_exists(path)) {
-						char *abs_path = os_get_abs_path_ptr(path);
-						obs_data_set_default_string(settings, param_name, abs_path);
-						bfree(abs_path);
-						param->has_default = true;
-					} else {
-						struct dstr texture_path = {0};
-						dstr_init(&texture_path);
-						dstr_cat(&texture_path, obs_get_module_data_path(obs_current_module()));
-						dstr_cat(&texture_path, "/textures/");
-						dstr_cat(&texture_path, path);
-						char *abs_path = os_get_abs_path_ptr(texture_path.array);
-						if (os_file_exists(abs_path)) {
-							obs_data_set_default_string(settings, param_name, abs_path);
-							param->has_default = true;
-						}
-						bfree(abs_path);
-						dstr_free(&texture_path);
-					}
+				if (param->default_texture_path && !obs_data_has_user_value(settings, param_name)) {
+					obs_data_set_default_string(settings, param_name, param->default_texture_path);
+					param->has_default = true;
 				}
-				path = obs_data_get_string(settings, param_name);
+				const char *path = obs_data_get_string(settings, param_name);
 				bool n = false;
 				if (param->image == NULL) {
 					param->image = bzalloc(sizeof(gs_image_file_t));
 					n = true;
 				}
-				if (n || !path || !param->path.array || strcmp(path, param->path.array) != 0) {
+				// An empty path leaves param->path freed, compare it as "" so the image is not reloaded.
+				if (n || strcmp(path ? path : "", param->path.array ? param->path.array : "") != 0) {
 
 					if (!n) {
 						obs_enter_graphics();
@@ -2984,21 +3501,272 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 				obs_data_set_default_string(settings, param_name,
 							    (const char *)default_value);
 				param->has_default = true;
-				bfree(param->default_value.string);
-				param->default_value.string =
-					bstrdup((const char *)default_value);
 			}
 			{
 				const char *str =
 					obs_data_get_string(settings, param_name);
-				bfree(param->value.string);
-				param->value.string = str ? bstrdup(str) : NULL;
+				if (!str || !binding->value.string || strcmp(str, binding->value.string) != 0) {
+					bfree(binding->value.string);
+					binding->value.string = str ? bstrdup(str) : NULL;
+				}
+			}
+			break;
+		default:;
+		}
+		binding->needs_upload = !shader_param_is_default(binding, default_value);
+	}
+
+	shader_filter_select_variant(filter);
+}
+
+static void shader_filter_finish_reload(struct shader_filter_data *filter)
+{
+	struct shader_compile_job *job = filter->compile_job;
+	if (!job || !os_atomic_load_bool(&job->done))
+		return;
+	filter->compile_job = NULL;
+
+	shader_watch_set_dependencies(filter, &job->dependencies);
+
+	obs_data_t *settings = shader_filter_get_settings(filter);
+	gs_effect_t *effect = NULL;
+	bool swap = true;
+
+	if (job->status == SHADER_COMPILE_NO_FILE) {
+		obs_data_unset_user_value(settings, "last_error");
+	} else if (job->status == SHADER_COMPILE_LOAD_FAILED) {
+		obs_data_set_string(settings, "last_error", obs_module_text("ShaderFilter.FileLoadFailed"));
+		swap = false;
+	} else {
+		char *errors = NULL;
+
+		obs_enter_graphics();
+		effect = shared_effect_acquire(job->effect_text, &errors);
+		obs_leave_graphics();
+
+		if (effect == NULL) {
+			blog(LOG_WARNING, "[obs-shaderfilter] Unable to create effect. Errors returned from parser:\n%s",
+			     (errors == NULL || strlen(errors) == 0 ? "(None)" : errors));
+			if (errors && strlen(errors)) {
+				obs_data_set_string(settings, "last_error", errors);
+			} else {
+				obs_data_set_string(settings, "last_error", obs_module_text("ShaderFilter.Unknown"));
+			}
+			swap = false;
+		} else {
+			obs_data_unset_user_value(settings, "last_error");
+		}
+		bfree(errors);
+	}
+
+	// Keep rendering the previous effect if the new one could not be built.
+	if (swap) {
+		filter->update_forced = true;
+		filter->content_hash = 0;
+		filter->shader_start_time = 0.0f;
+		shader_filter_clear_params(filter);
+		shader_filter_clear_variants(filter);
+
+		obs_enter_graphics();
+		shared_effect_release(filter->base_effect);
+		obs_leave_graphics();
+
+		filter->effect = filter->base_effect = effect;
+		filter->use_template = job->use_template;
+		filter->use_pm_alpha = job->use_pm_alpha;
+		filter->use_linear_input = job->use_linear_input;
+		filter->input_mips = job->input_mips;
+		free_pass_targets(&filter->pass_targets, &filter->pass_map);
+		da_move(filter->pass_targets, job->pass_targets);
+		da_move(filter->pass_map, job->pass_map);
+		bfree(filter->effect_text);
+		filter->effect_text = NULL;
+		if (effect) {
+			shader_filter_load_effect_params(filter);
+
+			// Keep the text around only if permutations have to be built from it.
+			for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+				if (filter->stored_param_list.array[i].specialize) {
+					filter->effect_text = job->effect_text;
+					job->effect_text = NULL;
+					break;
+				}
 			}
+		}
+
+		// Apply the current settings to the new parameters before the next render.
+		shader_filter_update(filter, settings);
+	}
+
+	if (!filter->auto_triggered_reload && !filter->stage_settings)
+		obs_source_update_properties(filter->context);
+	filter->auto_triggered_reload = false;
+
+	obs_data_release(settings);
+	shader_compile_job_release(job);
+}
+
+static bool shader_filter_decimated(const struct shader_filter_data *filter)
+{
+	return filter->update_interval > 1 || filter->update_rate > 0.0f;
+}
+
+/* True if nothing but the input and the uniforms set by the user changes what the shader draws. */
+static bool shader_filter_time_invariant(const struct shader_filter_data *filter)
+{
+	if (filter->transition || (filter->used_builtins & SHADER_BUILTIN_TIME_MASK))
+		return false;
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		if (filter->stored_param_list.array[i].source)
+			return false;
+	}
+	for (size_t i = 0; i < filter->stages.num; i++) {
+		if (!shader_filter_time_invariant(filter->stages.array[i]))
+			return false;
+	}
+	return true;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static uint64_t hash_string(uint64_t hash, const char *text)
+{
+	return text ? hash_bytes(hash, text, strlen(text)) : hash;
+}
+
+/*
+ * libobs does not tell filters whether their target drew a new frame, so the
+ * few targets that expose their state get a signature of it:
+ * - a paused, stopped or ended media source: state, playback time and size
+ * - a color source: its color and size
+ * - an image source showing a still image: the file, its modification time
+ *   and the size
+ * Returns false for everything else, including window and game captures and
+ * earlier filters, which may change on any frame.
+ */
+static bool shader_filter_input_signature(const struct shader_filter_data *filter, obs_source_t *target, uint64_t *signature)
+{
+	if (target != obs_filter_get_parent(filter->context))
+		return false;
+
+	uint64_t hash = 14695981039346656037ULL;
+	hash = hash_bytes(hash, &target, sizeof(target));
+	const uint32_t size[2] = {obs_source_get_base_width(target), obs_source_get_base_height(target)};
+	hash = hash_bytes(hash, size, sizeof(size));
+
+	const uint32_t flags = obs_source_get_output_flags(target);
+	if (flags & OBS_SOURCE_CONTROLLABLE_MEDIA) {
+		const enum obs_media_state state = obs_source_media_get_state(target);
+		if (state != OBS_MEDIA_STATE_PAUSED && state != OBS_MEDIA_STATE_STOPPED && state != OBS_MEDIA_STATE_ENDED)
+			return false;
+		const int64_t time = obs_source_media_get_time(target);
+		hash = hash_bytes(hash, &state, sizeof(state));
+		*signature = hash_bytes(hash, &time, sizeof(time));
+		return true;
+	}
+
+	const char *id = obs_source_get_unversioned_id(target);
+	if (!id)
+		return false;
+	if (strcmp(id, "color_source") == 0) {
+		obs_data_t *settings = obs_source_get_settings(target);
+		const long long color = obs_data_get_int(settings, "color");
+		obs_data_release(settings);
+		*signature = hash_bytes(hash, &color, sizeof(color));
+		return true;
+	}
+	if (strcmp(id, "image_source") != 0)
+		return false;
+
+	obs_data_t *settings = obs_source_get_settings(target);
+	const char *file = obs_data_get_string(settings, "file");
+	const char *extension = os_get_path_extension(file);
+	struct stat st;
+	const bool still = extension && astrcmpi(extension, ".gif") != 0 && os_stat(file, &st) == 0;
+	if (still) {
+		// The image source reloads the file when it changes on disk.
+		const int64_t modified = (int64_t)st.st_mtime;
+		hash = hash_string(hash, file);
+		*signature = hash_bytes(hash, &modified, sizeof(modified));
+	}
+	obs_data_release(settings);
+	return still;
+}
+
+/* Hashes the input signature and everything besides the input that the shader reads while drawing output_texrender. */
+static uint64_t shader_filter_content_hash(const struct shader_filter_data *filter)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	hash = hash_bytes(hash, &filter->input_signature, sizeof(filter->input_signature));
+	hash = hash_bytes(hash, &filter->effect, sizeof(filter->effect));
+	hash = hash_bytes(hash, &filter->render_width, sizeof(filter->render_width));
+	hash = hash_bytes(hash, &filter->render_height, sizeof(filter->render_height));
+	hash = hash_bytes(hash, &filter->uv_offset, sizeof(float) * 2);
+	hash = hash_bytes(hash, &filter->uv_scale, sizeof(float) * 2);
+	hash = hash_bytes(hash, &filter->uv_pixel_interval, sizeof(float) * 2);
+	hash = hash_bytes(hash, &filter->rand_activation_f, sizeof(filter->rand_activation_f));
+
+	for (size_t i = 0; i < filter->param_bindings.num; i++) {
+		const struct effect_param_binding *binding = filter->param_bindings.array + i;
+		if (!binding->param)
+			continue;
+		switch (binding->type) {
+		case GS_SHADER_PARAM_BOOL:
+		case GS_SHADER_PARAM_INT:
+			hash = hash_bytes(hash, &binding->value.i, sizeof(binding->value.i));
+			break;
+		case GS_SHADER_PARAM_FLOAT:
+			hash = hash_bytes(hash, &binding->value.f, sizeof(binding->value.f));
+			break;
+		case GS_SHADER_PARAM_VEC2:
+			hash = hash_bytes(hash, &binding->value.vec2, sizeof(float) * 2);
+			break;
+		case GS_SHADER_PARAM_VEC3:
+			hash = hash_bytes(hash, &binding->value.vec3, sizeof(float) * 3);
+			break;
+		case GS_SHADER_PARAM_VEC4:
+			hash = hash_bytes(hash, &binding->value.vec4, sizeof(float) * 4);
+			break;
+		case GS_SHADER_PARAM_TEXTURE:
+			hash = hash_bytes(hash, &filter->stored_param_list.array[i].image, sizeof(gs_image_file_t *));
+			break;
+		case GS_SHADER_PARAM_STRING:
+			hash = hash_string(hash, binding->value.string);
 			break;
 		default:;
 		}
-		bfree(default_value);
 	}
+
+	for (size_t i = 0; i < filter->stages.num; i++)
+		hash ^= shader_filter_content_hash(filter->stages.array[i]) * 31;
+	return hash ? hash : 1;
+}
+
+/*
+ * Decides whether the shader is drawn this frame or output_texrender is drawn
+ * again. The phase spreads instances with the same rate over the frames.
+ */
+static bool shader_filter_update_due(struct shader_filter_data *filter, float seconds)
+{
+	if (filter->update_rate > 0.0f) {
+		const float period = 1.0f / filter->update_rate;
+		filter->update_elapsed += seconds;
+		if (filter->update_elapsed < period)
+			return false;
+		filter->update_elapsed = fmodf(filter->update_elapsed, period);
+		return true;
+	}
+	if (filter->update_interval > 1)
+		return (shader_clock.frame + filter->update_phase) % (uint64_t)filter->update_interval == 0;
+	return true;
 }
 
 static void shader_filter_tick(void *data, float seconds)
@@ -3006,16 +3774,26 @@ static void shader_filter_tick(void *data, float seconds)
 	struct shader_filter_data *filter = data;
 	obs_source_t *target = filter->transition ? filter->context : obs_filter_get_target(filter->context);
 
+	if (os_atomic_set_bool(&filter->dependency_changed, false)) {
+		filter->auto_reload_pending = true;
+		filter->auto_reload_deadline = shader_clock.now_ns + 300000000ULL;
+	}
+
 	if (filter->auto_reload_pending) {
-		uint64_t now = os_gettime_ns();
-		if (now >= filter->auto_reload_deadline) {
+		if (shader_clock.now_ns >= filter->auto_reload_deadline) {
 			filter->auto_reload_pending = false;
 			filter->reload_effect = true;
 			filter->auto_triggered_reload = true;
-			obs_source_update(filter->context, NULL);
+			if (filter->stage_settings)
+				shader_filter_update(filter, filter->stage_settings);
+			else
+				obs_source_update(filter->context, NULL);
 		}
 	}
 
+	shader_filter_finish_reload(filter);
+	shader_filter_finish_variant(filter);
+
 	int base_width, base_height;
 	if (target) {
 		base_width = obs_source_get_base_width(target);
@@ -3047,8 +3825,10 @@ static void shader_filter_tick(void *data, float seconds)
 		filter->uv_pixel_interval.y = 1.0f / base_height;
 	}
 
-	filter->uv_size.x = (float)filter->total_width;
-	filter->uv_size.y = (float)filter->total_height;
+	filter->render_width = (int)fmaxf(1.0f, roundf((float)filter->total_width * filter->render_scale));
+	filter->render_height = (int)fmaxf(1.0f, roundf((float)filter->total_height * filter->render_scale));
+	filter->uv_size.x = (float)filter->render_width;
+	filter->uv_size.y = (float)filter->render_height;
 
 	filter->elapsed_time += seconds;
 	if (filter->shader_start_time == 0.0f) {
@@ -3063,7 +3843,7 @@ static void shader_filter_tick(void *data, float seconds)
 		if (filter->loops >= 4194304)
 			filter->loops = -filter->loops;
 	}
-	filter->local_time = (float)(os_gettime_ns() / 1000000000.0);
+	filter->local_time = shader_clock.local_time;
 	if (filter->enabled != obs_source_enabled(filter->context)) {
 		filter->enabled = !filter->enabled;
 		if (filter->enabled)
@@ -3082,7 +3862,7 @@ static void shader_filter_tick(void *data, float seconds)
 	}
 
 	// undecided between this and "rand_float(1);"
-	filter->rand_f = (float)((double)rand_interval(0, 10000) / (double)10000);
+	filter->rand_f = (float)((double)(rand_next(&filter->rand_state) % 10001) / (double)10000);
 
 	if (filter->volmeter) {
 		pthread_mutex_lock(&filter->audio_mutex);
@@ -3094,9 +3874,50 @@ static void shader_filter_tick(void *data, float seconds)
 		filter->audio_magnitude = 0.0f;
 	}
 
+	filter->update_due = shader_filter_update_due(filter, seconds) || filter->update_forced;
+	filter->update_forced = false;
+	filter->input_signature = 0;
+	filter->content_static = shader_filter_time_invariant(filter) &&
+				 (!target || shader_filter_input_signature(filter, target, &filter->input_signature));
+	filter->hold_output = shader_filter_decimated(filter) || filter->content_static;
+
 	filter->output_rendered = false;
 	filter->input_rendered = false;
 	filter->last_render_f = -1.0f;
+	filter->previous_renders = filter->renders;
+	filter->renders = 0;
+
+	// Leases end with the frame.
+	if (filter->input_leased) {
+		filter->input_texrender = NULL;
+		filter->input_leased = false;
+	}
+	if (filter->output_leased) {
+		filter->output_texrender = NULL;
+		filter->output_leased = false;
+	}
+	filter->stage_texrenders[0] = NULL;
+	filter->stage_texrenders[1] = NULL;
+	if (!filter->hold_output)
+		filter->stage_output = NULL;
+
+	// Stages shade the expanded output of this filter, so they see no expansion of their own.
+	for (size_t i = 0; i < filter->stages.num; i++) {
+		struct shader_filter_data *stage = filter->stages.array[i];
+		shader_filter_tick(stage, seconds);
+		stage->total_width = filter->render_width;
+		stage->total_height = filter->render_height;
+		stage->render_width = filter->render_width;
+		stage->render_height = filter->render_height;
+		stage->uv_scale.x = 1.0f;
+		stage->uv_scale.y = 1.0f;
+		stage->uv_offset.x = 0.0f;
+		stage->uv_offset.y = 0.0f;
+		stage->uv_pixel_interval.x = 1.0f / filter->render_width;
+		stage->uv_pixel_interval.y = 1.0f / filter->render_height;
+		stage->uv_size = filter->uv_size;
+		stage->hold_output = filter->hold_output;
+	}
 }
 
 static gs_texrender_t *create_or_reset_texrender(gs_texrender_t *render)
@@ -3109,6 +3930,46 @@ static gs_texrender_t *create_or_reset_texrender(gs_texrender_t *render)
 	return render;
 }
 
+/*
+ * Resets *render for a cx by cy draw of this frame. With swap, the shader reads
+ * the last result as *previous, with keep the result is drawn again in a later
+ * frame. Either way the filter owns the texrenders, otherwise *render is leased
+ * from the pool.
+ */
+static void shader_filter_frame_texrender(gs_texrender_t **render, gs_texrender_t **previous, bool *leased, bool swap, bool keep,
+					  uint32_t cx, uint32_t cy)
+{
+	if (swap || keep) {
+		if (*leased) {
+			*render = NULL;
+			*leased = false;
+		}
+		if (swap) {
+			gs_texrender_t *temp = *render;
+			*render = *previous;
+			*previous = temp;
+		} else if (*previous) {
+			gs_texrender_destroy(*previous);
+			*previous = NULL;
+		}
+		*render = create_or_reset_texrender(*render);
+		return;
+	}
+
+	if (*previous) {
+		gs_texrender_destroy(*previous);
+		*previous = NULL;
+	}
+	if (*render && *leased) {
+		gs_texrender_reset(*render);
+		return;
+	}
+	if (*render)
+		gs_texrender_destroy(*render);
+	*render = texrender_pool_lease(cx, cy, GS_RGBA);
+	*leased = true;
+}
+
 static void get_input_source(struct shader_filter_data *filter)
 {
 	if (filter->input_rendered)
@@ -3129,14 +3990,10 @@ static void get_input_source(struct shader_filter_data *filter)
 
 	const enum gs_color_format format = gs_get_format_from_space(source_space);
 
-	if (filter->param_previous_image) {
-		gs_texrender_t *temp = filter->input_texrender;
-		filter->input_texrender = filter->previous_input_texrender;
-		filter->previous_input_texrender = temp;
-	}
-
 	// Set up our input_texrender to catch the output texture.
-	filter->input_texrender = create_or_reset_texrender(filter->input_texrender);
+	const bool previous = filter->builtin_params[SHADER_BUILTIN_PREVIOUS_IMAGE] != NULL;
+	shader_filter_frame_texrender(&filter->input_texrender, &filter->previous_input_texrender, &filter->input_leased, previous,
+				      previous, filter->total_width, filter->total_height);
 
 	// Start the rendering process with our correct color space params,
 	// And set up your texrender to recieve the created texture.
@@ -3187,186 +4044,126 @@ static void draw_output(struct shader_filter_data *filter)
 		return;
 	}
 
-	gs_texture_t *texture = gs_texrender_get_texture(filter->output_texrender);
+	gs_texture_t *texture = gs_texrender_get_texture(filter->stage_output ? filter->stage_output : filter->output_texrender);
 	gs_effect_t *pass_through = filter->output_effect;
 	if (!pass_through)
 		pass_through = obs_get_base_effect(OBS_EFFECT_DEFAULT);
 
-	if (filter->param_output_image) {
-		gs_effect_set_texture(filter->param_output_image, texture);
+	if (filter->param_output_image) {
+		gs_effect_set_texture(filter->param_output_image, texture);
+	}
+
+	// A reduced render scale is upscaled by the bilinear sampler of render_output.effect.
+	const bool sharpen = filter->render_sharpen && filter->param_output_texel && filter->render_width < filter->total_width;
+	if (sharpen) {
+		struct vec2 texel;
+		texel.x = 1.0f / filter->render_width;
+		texel.y = 1.0f / filter->render_height;
+		gs_effect_set_vec2(filter->param_output_texel, &texel);
+	}
+
+	obs_source_process_filter_tech_end(filter->context, pass_through, filter->total_width, filter->total_height,
+					   sharpen ? "DrawSharpen" : "Draw");
+}
+
+/*
+ * Texture sources are rendered before any uniform is set: rendering them can
+ * draw other instances that share our effect and would overwrite its values.
+ */
+static void shader_filter_render_param_sources(struct shader_filter_data *filter)
+{
+	size_t param_count = filter->param_bindings.num;
+	for (size_t param_index = 0; param_index < param_count; param_index++) {
+		struct effect_param_binding *binding = (filter->param_bindings.array + param_index);
+		if (binding->type != GS_SHADER_PARAM_TEXTURE)
+			continue;
+		struct effect_param_data *param = (filter->stored_param_list.array + param_index);
+		param->source_rendered = false;
+		if (param->source_texture && !param->source) {
+			param_source_texture_release(param->source_texture);
+			param->source_texture = NULL;
+		}
+		if (!binding->param || !param->source)
+			continue;
+		obs_source_t *source = obs_weak_source_get_source(param->source);
+		if (!source)
+			continue;
+
+		const enum gs_color_space preferred_spaces[] = {
+			GS_CS_SRGB,
+			GS_CS_SRGB_16F,
+			GS_CS_709_EXTENDED,
+		};
+		const enum gs_color_space space = obs_source_get_color_space(source, OBS_COUNTOF(preferred_spaces), preferred_spaces);
+		const uint32_t base_width = obs_source_get_base_width(source);
+		const uint32_t base_height = obs_source_get_base_height(source);
+		struct param_source_texture *texture = param->source_texture;
+		if (!texture || texture->source != source || texture->cx != base_width || texture->cy != base_height ||
+		    texture->space != space) {
+			param_source_texture_release(texture);
+			texture = param->source_texture = param_source_texture_acquire(source, base_width, base_height, space);
+		}
+		param_source_texture_render(texture, source);
+		obs_source_release(source);
+		param->source_rendered = true;
 	}
-
-	obs_source_process_filter_end(filter->context, pass_through, filter->total_width, filter->total_height);
 }
 
 static void shader_filter_set_effect_params(struct shader_filter_data *filter)
 {
+	shader_filter_render_param_sources(filter);
 
-	if (filter->param_uv_scale != NULL) {
-		gs_effect_set_vec2(filter->param_uv_scale, &filter->uv_scale);
-	}
-	if (filter->param_uv_offset != NULL) {
-		gs_effect_set_vec2(filter->param_uv_offset, &filter->uv_offset);
-	}
-	if (filter->param_uv_pixel_interval != NULL) {
-		gs_effect_set_vec2(filter->param_uv_pixel_interval, &filter->uv_pixel_interval);
-	}
-	if (filter->param_current_time_ms != NULL) {
-#ifdef _WIN32
-		SYSTEMTIME system_time;
-		GetSystemTime(&system_time);
-		gs_effect_set_int(filter->param_current_time_ms, system_time.wMilliseconds);
-#else
-		struct timeval tv;
-		gettimeofday(&tv, NULL);
-		gs_effect_set_int(filter->param_current_time_ms, tv.tv_usec / 1000);
-#endif
-	}
-	if (filter->param_current_time_sec != NULL || filter->param_current_time_min != NULL ||
-	    filter->param_current_time_hour != NULL || filter->param_current_time_day_of_week != NULL ||
-	    filter->param_current_time_day_of_month != NULL || filter->param_current_time_month != NULL ||
-	    filter->param_current_time_day_of_year != NULL || filter->param_current_time_year != NULL) {
-		time_t t = time(NULL);
-		struct tm *lt = localtime(&t);
-		if (filter->param_current_time_sec != NULL)
-			gs_effect_set_int(filter->param_current_time_sec, lt->tm_sec);
-		if (filter->param_current_time_min != NULL)
-			gs_effect_set_int(filter->param_current_time_min, lt->tm_min);
-		if (filter->param_current_time_hour != NULL)
-			gs_effect_set_int(filter->param_current_time_hour, lt->tm_hour);
-		if (filter->param_current_time_day_of_week != NULL)
-			gs_effect_set_int(filter->param_current_time_day_of_week, lt->tm_wday);
-		if (filter->param_current_time_day_of_month != NULL)
-			gs_effect_set_int(filter->param_current_time_day_of_month, lt->tm_mday);
-		if (filter->param_current_time_month != NULL)
-			gs_effect_set_int(filter->param_current_time_month, lt->tm_mon);
-		if (filter->param_current_time_day_of_year != NULL)
-			gs_effect_set_int(filter->param_current_time_day_of_year, lt->tm_yday);
-		if (filter->param_current_time_year != NULL)
-			gs_effect_set_int(filter->param_current_time_year, lt->tm_year);
-	}
-	if (filter->param_elapsed_time != NULL) {
-		gs_effect_set_float(filter->param_elapsed_time, filter->elapsed_time);
-	}
-	if (filter->param_elapsed_time_start != NULL) {
-		gs_effect_set_float(filter->param_elapsed_time_start, filter->elapsed_time - filter->shader_start_time);
-	}
-	if (filter->param_elapsed_time_show != NULL) {
-		gs_effect_set_float(filter->param_elapsed_time_show, filter->shader_show_time);
-	}
-	if (filter->param_elapsed_time_active != NULL) {
-		gs_effect_set_float(filter->param_elapsed_time_active, filter->shader_active_time);
-	}
-	if (filter->param_elapsed_time_enable != NULL) {
-		gs_effect_set_float(filter->param_elapsed_time_enable, filter->elapsed_time - filter->shader_enable_time);
-	}
-	if (filter->param_uv_size != NULL) {
-		gs_effect_set_vec2(filter->param_uv_size, &filter->uv_size);
-	}
-	if (filter->param_local_time != NULL) {
-		gs_effect_set_float(filter->param_local_time, filter->local_time);
-	}
-	if (filter->param_audio_peak != NULL) {
-		gs_effect_set_float(filter->param_audio_peak, filter->audio_peak);
-	}
-	if (filter->param_audio_magnitude != NULL) {
-		gs_effect_set_float(filter->param_audio_magnitude, filter->audio_magnitude);
-	}
-	if (filter->param_loops != NULL) {
-		gs_effect_set_int(filter->param_loops, filter->loops);
-	}
-	if (filter->param_loop_second != NULL) {
-		gs_effect_set_float(filter->param_loop_second, filter->elapsed_time_loop);
-	}
-	if (filter->param_rand_f != NULL) {
-		gs_effect_set_float(filter->param_rand_f, filter->rand_f);
-	}
-	if (filter->param_rand_activation_f != NULL) {
-		gs_effect_set_float(filter->param_rand_activation_f, filter->rand_activation_f);
-	}
-	if (filter->param_rand_instance_f != NULL) {
-		gs_effect_set_float(filter->param_rand_instance_f, filter->rand_instance_f);
+	uint64_t used = filter->used_builtins & (SHADER_BUILTIN_BIT(SHADER_BUILTIN_NUM_UPLOADED) - 1);
+	while (used) {
+		int id = lowest_set_bit(used);
+		used &= used - 1;
+		shader_builtins[id].upload(filter, filter->builtin_params[id], &shader_clock);
 	}
 
-	size_t param_count = filter->stored_param_list.num;
+	size_t param_count = filter->param_bindings.num;
 	for (size_t param_index = 0; param_index < param_count; param_index++) {
-		struct effect_param_data *param = (filter->stored_param_list.array + param_index);
-		if (!param->param)
+		struct effect_param_binding *binding = (filter->param_bindings.array + param_index);
+		if (!binding->param)
 			continue;
-		obs_source_t *source = NULL;
+		if (!binding->needs_upload) {
+			filter->uniform_uploads_skipped++;
+			continue;
+		}
+		filter->uniform_uploads++;
 
-		switch (param->type) {
+		switch (binding->type) {
 		case GS_SHADER_PARAM_BOOL:
-			gs_effect_set_bool(param->param, param->value.i);
+			gs_effect_set_bool(binding->param, binding->value.i);
 			break;
 		case GS_SHADER_PARAM_FLOAT:
-			gs_effect_set_float(param->param, (float)param->value.f);
+			gs_effect_set_float(binding->param, (float)binding->value.f);
 			break;
 		case GS_SHADER_PARAM_INT:
-			gs_effect_set_int(param->param, (int)param->value.i);
+			gs_effect_set_int(binding->param, (int)binding->value.i);
 			break;
 		case GS_SHADER_PARAM_VEC2:
-			gs_effect_set_vec2(param->param, &param->value.vec2);
+			gs_effect_set_vec2(binding->param, &binding->value.vec2);
 			break;
 		case GS_SHADER_PARAM_VEC3:
-			gs_effect_set_vec3(param->param, &param->value.vec3);
+			gs_effect_set_vec3(binding->param, &binding->value.vec3);
 			break;
 		case GS_SHADER_PARAM_VEC4:
-			gs_effect_set_vec4(param->param, &param->value.vec4);
+			gs_effect_set_vec4(binding->param, &binding->value.vec4);
 			break;
-		case GS_SHADER_PARAM_TEXTURE:
-			source = obs_weak_source_get_source(param->source);
-			if (source) {
-				const enum gs_color_space preferred_spaces[] = {
-					GS_CS_SRGB,
-					GS_CS_SRGB_16F,
-					GS_CS_709_EXTENDED,
-				};
-				const enum gs_color_space space =
-					obs_source_get_color_space(source, OBS_COUNTOF(preferred_spaces), preferred_spaces);
-				const enum gs_color_format format = gs_get_format_from_space(space);
-				if (!param->render || gs_texrender_get_format(param->render) != format) {
-					gs_texrender_destroy(param->render);
-					param->render = gs_texrender_create(format, GS_ZS_NONE);
-				} else {
-					gs_texrender_reset(param->render);
-				}
-				uint32_t base_width = obs_source_get_base_width(source);
-				uint32_t base_height = obs_source_get_base_height(source);
-				gs_blend_state_push();
-				gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
-				if (gs_texrender_begin_with_color_space(param->render, base_width, base_height, space)) {
-					const float w = (float)base_width;
-					const float h = (float)base_height;
-					uint32_t flags = obs_source_get_output_flags(source);
-					const bool custom_draw = (flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
-					const bool async = (flags & OBS_SOURCE_ASYNC) != 0;
-					struct vec4 clear_color;
-
-					vec4_zero(&clear_color);
-					gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
-					gs_ortho(0.0f, w, 0.0f, h, -100.0f, 100.0f);
-
-					if (!custom_draw && !async)
-						obs_source_default_render(source);
-					else
-						obs_source_video_render(source);
-					gs_texrender_end(param->render);
-				}
-				gs_blend_state_pop();
-				obs_source_release(source);
-				gs_texture_t *tex = gs_texrender_get_texture(param->render);
-				gs_effect_set_texture(param->param, tex);
+		case GS_SHADER_PARAM_TEXTURE: {
+			struct effect_param_data *param = (filter->stored_param_list.array + param_index);
+			if (param->source_rendered) {
+				gs_effect_set_texture(binding->param, gs_texrender_get_texture(param->source_texture->render));
 			} else if (param->image) {
-				gs_effect_set_texture(param->param, param->image->texture);
+				gs_effect_set_texture(binding->param, param->image->texture);
 			} else {
-				gs_effect_set_texture(param->param, NULL);
+				gs_effect_set_texture(binding->param, NULL);
 			}
-
 			break;
+		}
 		case GS_SHADER_PARAM_STRING:
-			gs_effect_set_val(param->param, (param->value.string ? param->value.string : NULL),
-					  gs_effect_get_val_size(param->param));
+			gs_effect_set_val(binding->param, (binding->value.string ? binding->value.string : NULL),
+					  gs_effect_get_val_size(binding->param));
 			break;
 		default:;
 		}
@@ -3392,122 +4189,277 @@ static inline void build_sprite_norm(struct gs_vb_data *data, float fcx, float f
 	build_sprite(data, fcx, fcy, 0.0f, 1.0f, 0.0f, 1.0f);
 }
 
-static void render_shader(struct shader_filter_data *filter, float f, obs_source_t *filter_to)
+/* Pairs up the params of filter and filter2 that move-transition interpolates, once per param list. */
+static void shader_filter_update_interp_pairs(struct shader_filter_data *filter, struct shader_filter_data *filter2)
 {
-	gs_texture_t *texture = gs_texrender_get_texture(filter->input_texrender);
-	if (!texture) {
+	if (filter->interp_target == filter2 && filter->interp_generation == filter->param_generation &&
+	    filter->interp_target_generation == filter2->param_generation)
+		return;
+
+	filter->interp_target = filter2;
+	filter->interp_generation = filter->param_generation;
+	filter->interp_target_generation = filter2->param_generation;
+	da_resize(filter->interp_pairs, 0);
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		struct effect_param_data *param = filter->stored_param_list.array + i;
+		for (size_t j = 0; j < filter2->stored_param_list.num; j++) {
+			struct effect_param_data *param2 = filter2->stored_param_list.array + j;
+			if (param->type != param2->type || strcmp(param->name.array, param2->name.array) != 0)
+				continue;
+			struct param_interp_pair *pair = da_push_back_new(filter->interp_pairs);
+			pair->from = i;
+			pair->to = j;
+			break;
+		}
+	}
+}
+
+static void shader_filter_draw_sprite(struct shader_filter_data *filter, gs_texture_t *texture, uint32_t cx, uint32_t cy)
+{
+	if (filter->use_template || filter->source) {
+		gs_draw_sprite(texture, 0, cx, cy);
 		return;
 	}
 
-	if (filter->param_previous_output) {
-		gs_texrender_t *temp = filter->output_texrender;
-		filter->output_texrender = filter->previous_output_texrender;
-		filter->previous_output_texrender = temp;
+	if (!filter->sprite_buffer)
+		load_sprite_buffer(filter);
+
+	struct gs_vb_data *data = gs_vertexbuffer_get_data(filter->sprite_buffer);
+	build_sprite_norm(data, (float)cx, (float)cy);
+	gs_vertexbuffer_flush(filter->sprite_buffer);
+	gs_load_vertexbuffer(filter->sprite_buffer);
+	gs_load_indexbuffer(NULL);
+	gs_draw(GS_TRISTRIP, 0, 0);
+}
+
+/*
+ * Runs the Draw technique pass by pass, each into its PASS<n>_TARGET or into
+ * output, which is NULL to draw the output passes into the current target.
+ * The targets drawn so far are bound before every pass, except the one being
+ * drawn. Targets only hold their contents until the last pass.
+ */
+static void shader_filter_draw_passes(struct shader_filter_data *filter, gs_texture_t *texture, gs_texrender_t *output,
+				      uint32_t cx, uint32_t cy)
+{
+	gs_technique_t *tech = gs_effect_get_technique(filter->effect, "Draw");
+	size_t passes = gs_technique_begin(tech);
+	for (size_t pass = 0; pass < passes; pass++) {
+		size_t target_index = pass < filter->pass_map.num ? filter->pass_map.array[pass] : 0;
+		struct shader_pass_target *target = target_index ? filter->pass_targets.array + target_index - 1 : NULL;
+		gs_texrender_t *render = output;
+		uint32_t render_cx = cx;
+		uint32_t render_cy = cy;
+		if (target) {
+			render_cx = (uint32_t)fmaxf(1.0f, roundf((float)cx * target->scale));
+			render_cy = (uint32_t)fmaxf(1.0f, roundf((float)cy * target->scale));
+			if (!target->render)
+				target->render = texrender_pool_lease(render_cx, render_cy, target->format);
+			render = target->render;
+		}
+
+		if (render) {
+			gs_texrender_reset(render);
+			if (!gs_texrender_begin(render, render_cx, render_cy))
+				continue;
+			gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+		}
+		if (target) {
+			gs_blend_state_push();
+			gs_reset_blend_state();
+			gs_enable_blending(false);
+		}
+
+		for (size_t i = 0; i < filter->pass_targets.num; i++) {
+			struct shader_pass_target *input = filter->pass_targets.array + i;
+			if (input->param)
+				gs_effect_set_texture(input->param, input == target ? NULL : gs_texrender_get_texture(input->render));
+		}
+		if (gs_technique_begin_pass(tech, pass)) {
+			shader_filter_draw_sprite(filter, texture, cx, cy);
+			gs_technique_end_pass(tech);
+		}
+
+		if (target)
+			gs_blend_state_pop();
+		if (render)
+			gs_texrender_end(render);
+	}
+	gs_technique_end(tech);
+
+	for (size_t i = 0; i < filter->pass_targets.num; i++) {
+		struct shader_pass_target *target = filter->pass_targets.array + i;
+		if (target->render) {
+			texrender_pool_release(target->render);
+			target->render = NULL;
+		}
+	}
+}
+
+/* Downsamples texture into the levels the shader reads as image_mip<n>, each with the bilinear sampler of the default effect. */
+static void shader_filter_render_input_mips(struct shader_filter_data *filter, gs_texture_t *texture)
+{
+	if (!filter->input_mips)
+		return;
+
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+	uint32_t cx = gs_texture_get_width(texture);
+	uint32_t cy = gs_texture_get_height(texture);
+
+	// The levels hold the same nonlinear values as the input.
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(false);
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_enable_blending(false);
+	for (int i = 0; i < filter->input_mips && texture; i++) {
+		cx = cx > 1 ? cx / 2 : 1;
+		cy = cy > 1 ? cy / 2 : 1;
+		gs_texrender_t *render = texrender_pool_lease(cx, cy, GS_RGBA);
+		filter->input_mip_texrenders[i] = render;
+		if (gs_texrender_begin(render, cx, cy)) {
+			gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+			gs_effect_set_texture(image, texture);
+			while (gs_effect_loop(effect, "Draw"))
+				gs_draw_sprite(texture, 0, cx, cy);
+			gs_texrender_end(render);
+		}
+		texture = gs_texrender_get_texture(render);
 	}
-	filter->output_texrender = create_or_reset_texrender(filter->output_texrender);
+	gs_blend_state_pop();
+	gs_enable_framebuffer_srgb(previous);
+}
 
-	if (filter->param_image)
-		gs_effect_set_texture(filter->param_image, texture);
-	if (filter->param_previous_image)
-		gs_effect_set_texture(filter->param_previous_image, gs_texrender_get_texture(filter->previous_input_texrender));
-	if (filter->param_previous_output)
-		gs_effect_set_texture(filter->param_previous_output, gs_texrender_get_texture(filter->previous_output_texrender));
+static void shader_filter_release_input_mips(struct shader_filter_data *filter)
+{
+	for (size_t i = 0; i < OBS_COUNTOF(filter->input_mip_texrenders); i++) {
+		if (filter->input_mip_texrenders[i]) {
+			texrender_pool_release(filter->input_mip_texrenders[i]);
+			filter->input_mip_texrenders[i] = NULL;
+		}
+	}
+}
 
+/* Sets the uniforms for a draw of filter, the values move-transition fades between included. */
+static void shader_filter_set_render_params(struct shader_filter_data *filter, gs_texture_t *texture, float f,
+					    obs_source_t *filter_to)
+{
+	gs_eparam_t **builtins = filter->builtin_params;
+	if (texture)
+		shader_filter_render_input_mips(filter, texture);
 	shader_filter_set_effect_params(filter);
 
+	if (builtins[SHADER_BUILTIN_IMAGE] && texture)
+		gs_effect_set_texture(builtins[SHADER_BUILTIN_IMAGE], texture);
+	for (int i = 0; i < filter->input_mips; i++) {
+		if (filter->input_mip_params[i])
+			gs_effect_set_texture(filter->input_mip_params[i], gs_texrender_get_texture(filter->input_mip_texrenders[i]));
+	}
+	if (builtins[SHADER_BUILTIN_PREVIOUS_IMAGE])
+		gs_effect_set_texture(builtins[SHADER_BUILTIN_PREVIOUS_IMAGE], gs_texrender_get_texture(filter->previous_input_texrender));
+	if (builtins[SHADER_BUILTIN_PREVIOUS_OUTPUT])
+		gs_effect_set_texture(builtins[SHADER_BUILTIN_PREVIOUS_OUTPUT], gs_texrender_get_texture(filter->previous_output_texrender));
+
 	if (f > 0.0f) {
 		if (filter_to) {
 
 			struct shader_filter_data *filter2 = obs_obj_get_data(filter_to);
-			for (size_t i = 0; i < filter->stored_param_list.num; i++) {
-				struct effect_param_data *param = (filter->stored_param_list.array + i);
-				if (!param->param)
+			shader_filter_update_interp_pairs(filter, filter2);
+			for (size_t i = 0; i < filter->interp_pairs.num; i++) {
+				const struct param_interp_pair *pair = filter->interp_pairs.array + i;
+				struct effect_param_binding *binding = filter->param_bindings.array + pair->from;
+				struct effect_param_binding *binding2 = filter2->param_bindings.array + pair->to;
+				if (!binding->param || !binding2->param)
 					continue;
 
-				for (size_t j = 0; j < filter2->stored_param_list.num; j++) {
-					struct effect_param_data *param2 = (filter2->stored_param_list.array + j);
-					if (!param2->param)
-						continue;
-					if (param->type != param2->type)
-						continue;
-					if (strcmp(param->name.array, param2->name.array) != 0)
-						continue;
-
-					switch (param->type) {
-					case GS_SHADER_PARAM_FLOAT:
-						gs_effect_set_float(param->param, (float)param2->value.f * f +
-											  (float)param->value.f * (1.0f - f));
-						break;
-					case GS_SHADER_PARAM_INT:
-						gs_effect_set_int(param->param, (int)((double)param2->value.i * f +
-										      (double)param->value.i * (1.0f - f)));
-						break;
-					case GS_SHADER_PARAM_VEC2: {
-						struct vec2 v2;
-						v2.x = (float)param2->value.vec2.x * f + (float)param->value.vec2.x * (1.0f - f);
-						v2.y = (float)param2->value.vec2.y * f + (float)param->value.vec2.y * (1.0f - f);
-						gs_effect_set_vec2(param->param, &v2);
-						break;
-					}
-					case GS_SHADER_PARAM_VEC3: {
-						struct vec3 v3;
-						v3.x = (float)param2->value.vec3.x * f + (float)param->value.vec3.x * (1.0f - f);
-						v3.y = (float)param2->value.vec3.y * f + (float)param->value.vec3.y * (1.0f - f);
-						v3.z = (float)param2->value.vec3.z * f + (float)param->value.vec3.z * (1.0f - f);
-						gs_effect_set_vec3(param->param, &v3);
-						break;
-					}
-					case GS_SHADER_PARAM_VEC4: {
-						struct vec4 v4;
-						v4.x = (float)param2->value.vec4.x * f + (float)param->value.vec4.x * (1.0f - f);
-						v4.y = (float)param2->value.vec4.y * f + (float)param->value.vec4.y * (1.0f - f);
-						v4.z = (float)param2->value.vec4.z * f + (float)param->value.vec4.z * (1.0f - f);
-						v4.w = (float)param2->value.vec4.w * f + (float)param->value.vec4.w * (1.0f - f);
-						gs_effect_set_vec4(param->param, &v4);
-						break;
-					}
-					default:;
-					}
+				switch (binding->type) {
+				case GS_SHADER_PARAM_BOOL:
+					if (f >= 0.5f)
+						gs_effect_set_bool(binding->param, binding2->value.i);
+					break;
+				case GS_SHADER_PARAM_FLOAT:
+					gs_effect_set_float(binding->param, (float)binding2->value.f * f + (float)binding->value.f * (1.0f - f));
+					break;
+				case GS_SHADER_PARAM_INT:
+					gs_effect_set_int(binding->param,
+							  (int)((double)binding2->value.i * f + (double)binding->value.i * (1.0f - f)));
+					break;
+				case GS_SHADER_PARAM_VEC2: {
+					struct vec2 v2;
+					v2.x = (float)binding2->value.vec2.x * f + (float)binding->value.vec2.x * (1.0f - f);
+					v2.y = (float)binding2->value.vec2.y * f + (float)binding->value.vec2.y * (1.0f - f);
+					gs_effect_set_vec2(binding->param, &v2);
+					break;
+				}
+				case GS_SHADER_PARAM_VEC3: {
+					struct vec3 v3;
+					v3.x = (float)binding2->value.vec3.x * f + (float)binding->value.vec3.x * (1.0f - f);
+					v3.y = (float)binding2->value.vec3.y * f + (float)binding->value.vec3.y * (1.0f - f);
+					v3.z = (float)binding2->value.vec3.z * f + (float)binding->value.vec3.z * (1.0f - f);
+					gs_effect_set_vec3(binding->param, &v3);
+					break;
+				}
+				case GS_SHADER_PARAM_VEC4: {
+					struct vec4 v4;
+					v4.x = (float)binding2->value.vec4.x * f + (float)binding->value.vec4.x * (1.0f - f);
+					v4.y = (float)binding2->value.vec4.y * f + (float)binding->value.vec4.y * (1.0f - f);
+					v4.z = (float)binding2->value.vec4.z * f + (float)binding->value.vec4.z * (1.0f - f);
+					v4.w = (float)binding2->value.vec4.w * f + (float)binding->value.vec4.w * (1.0f - f);
+					gs_effect_set_vec4(binding->param, &v4);
+					break;
+				}
+				case GS_SHADER_PARAM_TEXTURE: {
+					// The target filter does not render, so only its image files and
+					// sources it rendered earlier have a texture to switch to.
+					struct effect_param_data *param2 = filter2->stored_param_list.array + pair->to;
+					gs_texture_t *texture = param2->image ? param2->image->texture
+							      : param2->source_texture ? gs_texrender_get_texture(param2->source_texture->render)
+										       : NULL;
+					if (f >= 0.5f && texture)
+						gs_effect_set_texture(binding->param, texture);
 					break;
 				}
+				default:;
+				}
 			}
 		} else {
 			for (size_t i = 0; i < filter->stored_param_list.num; i++) {
 				struct effect_param_data *param = (filter->stored_param_list.array + i);
-				if (!param->param || !param->has_default)
+				struct effect_param_binding *binding = (filter->param_bindings.array + i);
+				if (!binding->param || !param->has_default)
 					continue;
 
 				switch (param->type) {
 				case GS_SHADER_PARAM_FLOAT:
-					gs_effect_set_float(param->param,
-							    (float)param->default_value.f * f + (float)param->value.f * (1.0f - f));
+					gs_effect_set_float(binding->param,
+							    (float)param->default_value.f * f + (float)binding->value.f * (1.0f - f));
 					break;
 				case GS_SHADER_PARAM_INT:
-					gs_effect_set_int(param->param, (int)((double)param->default_value.i * f +
-									      (double)param->value.i * (1.0f - f)));
+					gs_effect_set_int(binding->param, (int)((double)param->default_value.i * f +
+									      (double)binding->value.i * (1.0f - f)));
 					break;
 				case GS_SHADER_PARAM_VEC2: {
 					struct vec2 v2;
-					v2.x = param->default_value.vec2.x * f + param->value.vec2.x * (1.0f - f);
-					v2.y = param->default_value.vec2.y * f + param->value.vec2.y * (1.0f - f);
-					gs_effect_set_vec2(param->param, &v2);
+					v2.x = param->default_value.vec2.x * f + binding->value.vec2.x * (1.0f - f);
+					v2.y = param->default_value.vec2.y * f + binding->value.vec2.y * (1.0f - f);
+					gs_effect_set_vec2(binding->param, &v2);
 					break;
 				}
 				case GS_SHADER_PARAM_VEC3: {
 					struct vec3 v3;
-					v3.x = param->default_value.vec3.x * f + param->value.vec3.x * (1.0f - f);
-					v3.y = param->default_value.vec3.y * f + param->value.vec3.y * (1.0f - f);
-					v3.z = param->default_value.vec3.z * f + param->value.vec3.z * (1.0f - f);
-					gs_effect_set_vec3(param->param, &v3);
+					v3.x = param->default_value.vec3.x * f + binding->value.vec3.x * (1.0f - f);
+					v3.y = param->default_value.vec3.y * f + binding->value.vec3.y * (1.0f - f);
+					v3.z = param->default_value.vec3.z * f + binding->value.vec3.z * (1.0f - f);
+					gs_effect_set_vec3(binding->param, &v3);
 					break;
 				}
 				case GS_SHADER_PARAM_VEC4: {
 					struct vec4 v4;
-					v4.x = param->default_value.vec4.x * f + param->value.vec4.x * (1.0f - f);
-					v4.y = param->default_value.vec4.y * f + param->value.vec4.y * (1.0f - f);
-					v4.z = param->default_value.vec4.z * f + param->value.vec4.z * (1.0f - f);
-					v4.w = param->default_value.vec4.w * f + param->value.vec4.w * (1.0f - f);
-					gs_effect_set_vec4(param->param, &v4);
+					v4.x = param->default_value.vec4.x * f + binding->value.vec4.x * (1.0f - f);
+					v4.y = param->default_value.vec4.y * f + binding->value.vec4.y * (1.0f - f);
+					v4.z = param->default_value.vec4.z * f + binding->value.vec4.z * (1.0f - f);
+					v4.w = param->default_value.vec4.w * f + binding->value.vec4.w * (1.0f - f);
+					gs_effect_set_vec4(binding->param, &v4);
 					break;
 				}
 				default:;
@@ -3515,33 +4467,215 @@ static void render_shader(struct shader_filter_data *filter, float f, obs_source
 			}
 		}
 	}
+}
+
+static void render_shader(struct shader_filter_data *filter, gs_texture_t *texture, float f, obs_source_t *filter_to)
+{
+	gs_eparam_t **builtins = filter->builtin_params;
+
+	shader_filter_frame_texrender(&filter->output_texrender, &filter->previous_output_texrender, &filter->output_leased,
+				      builtins[SHADER_BUILTIN_PREVIOUS_OUTPUT] != NULL, filter->hold_output, filter->render_width,
+				      filter->render_height);
+
+	shader_filter_set_render_params(filter, texture, f, filter_to);
 
 	gs_blend_state_push();
 	gs_reset_blend_state();
 	gs_enable_blending(false);
 	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
 
-	if (gs_texrender_begin(filter->output_texrender, filter->total_width, filter->total_height)) {
-		gs_ortho(0.0f, (float)filter->total_width, 0.0f, (float)filter->total_height, -100.0f, 100.0f);
-		while (gs_effect_loop(filter->effect, "Draw")) {
-			if (filter->use_template) {
-				gs_draw_sprite(texture, 0, filter->total_width, filter->total_height);
-			} else {
-				if (!filter->sprite_buffer)
-					load_sprite_buffer(filter);
-
-				struct gs_vb_data *data = gs_vertexbuffer_get_data(filter->sprite_buffer);
-				build_sprite_norm(data, (float)filter->total_width, (float)filter->total_height);
-				gs_vertexbuffer_flush(filter->sprite_buffer);
-				gs_load_vertexbuffer(filter->sprite_buffer);
-				gs_load_indexbuffer(NULL);
-				gs_draw(GS_TRISTRIP, 0, 0);
-			}
-		}
+	if (filter->pass_map.num) {
+		shader_filter_draw_passes(filter, texture, filter->output_texrender, filter->render_width, filter->render_height);
+	} else if (gs_texrender_begin(filter->output_texrender, filter->render_width, filter->render_height)) {
+		gs_ortho(0.0f, (float)filter->render_width, 0.0f, (float)filter->render_height, -100.0f, 100.0f);
+		while (gs_effect_loop(filter->effect, "Draw"))
+			shader_filter_draw_sprite(filter, texture, filter->render_width, filter->render_height);
 		gs_texrender_end(filter->output_texrender);
+	} else {
+		// Run the technique empty so the values set above do not leak into the next instance
+		// that draws this effect and relies on its defaults.
+		gs_technique_t *tech = gs_effect_get_technique(filter->effect, "Draw");
+		if (gs_technique_begin(tech))
+			gs_technique_end(tech);
 	}
 
 	gs_blend_state_pop();
+	shader_filter_release_input_mips(filter);
+}
+
+/*
+ * Runs the stages on the output of the filter's own shader. Stages read the
+ * previous result directly and alternate between two shared texrenders,
+ * only a stage that samples previous_output or is drawn again in later
+ * frames needs one of its own.
+ */
+static void render_stages(struct shader_filter_data *filter)
+{
+	gs_texture_t *texture = gs_texrender_get_texture(filter->output_texrender);
+	size_t rendered = 0;
+	filter->stage_output = NULL;
+	for (size_t i = 0; i < filter->stages.num && texture; i++) {
+		struct shader_filter_data *stage = filter->stages.array[i];
+		if (!stage->effect)
+			continue;
+
+		gs_texrender_t **pooled = stage->builtin_params[SHADER_BUILTIN_PREVIOUS_OUTPUT] || filter->hold_output
+						  ? NULL
+						  : &filter->stage_texrenders[rendered & 1];
+		if (pooled) {
+			stage->output_texrender = *pooled;
+			stage->output_leased = *pooled != NULL;
+		}
+		render_shader(stage, texture, 0.0f, NULL);
+		filter->stage_output = stage->output_texrender;
+		if (pooled) {
+			*pooled = stage->output_texrender;
+			stage->output_texrender = NULL;
+			stage->output_leased = false;
+		}
+		texture = gs_texrender_get_texture(filter->stage_output);
+		rendered++;
+	}
+}
+
+/*
+ * A shader that takes premultiplied, linear input (USE_PM_ALPHA and
+ * USE_LINEAR_INPUT) and needs nothing but the current frame at its own size
+ * does not need the input and output copies. It runs as the effect of
+ * obs_source_process_filter_end, so libobs draws the parent straight through
+ * it when it can. libobs decodes image from sRGB on that path, which is why
+ * the shader has to ask for it: the copies hand it nonlinear values.
+ */
+static bool shader_filter_can_render_direct(const struct shader_filter_data *filter)
+{
+	return filter->use_pm_alpha && filter->use_linear_input && filter->render_scale == 1.0f && !filter->hold_output && !filter->input_mips &&
+	       !filter->transition && !filter->source && !filter->stages.num && !filter->pass_map.num &&
+	       !filter->expand_left && !filter->expand_right && !filter->expand_top && !filter->expand_bottom &&
+	       !filter->builtin_params[SHADER_BUILTIN_PREVIOUS_IMAGE] && !filter->builtin_params[SHADER_BUILTIN_PREVIOUS_OUTPUT];
+}
+
+/* Returns false if the target is not sRGB, those still go through the texrenders and render_output.effect. */
+static bool render_shader_direct(struct shader_filter_data *filter, float f, obs_source_t *filter_to)
+{
+	const enum gs_color_space preferred_spaces[] = {
+		GS_CS_SRGB,
+		GS_CS_SRGB_16F,
+		GS_CS_709_EXTENDED,
+	};
+
+	const enum gs_color_space source_space =
+		obs_source_get_color_space(obs_filter_get_target(filter->context), OBS_COUNTOF(preferred_spaces), preferred_spaces);
+	if (source_space != GS_CS_SRGB)
+		return false;
+
+	if (!obs_source_process_filter_begin_with_color_space(filter->context, GS_RGBA, source_space, OBS_ALLOW_DIRECT_RENDERING)) {
+		obs_source_skip_video_filter(filter->context);
+		return true;
+	}
+
+	// libobs binds image with sRGB decoding and encodes the result, the shader works on linear values.
+	shader_filter_set_render_params(filter, NULL, f, filter_to);
+	obs_source_process_filter_end(filter->context, filter->effect, filter->total_width, filter->total_height);
+	return true;
+}
+
+/*
+ * Without feedback through previous_output, at full render scale and rate and
+ * with one draw per frame, output_texrender and render_output.effect are skipped. The DrawLinear
+ * technique applies the same sRGB conversion while drawing to the target,
+ * with linear_srgb and framebuffer sRGB on as process_filter_tech_end turns
+ * them on for this OBS_SOURCE_SRGB filter in draw_output.
+ * Returns false if the effect has no DrawLinear technique or the target
+ * is not sRGB.
+ */
+static bool render_shader_to_target(struct shader_filter_data *filter, gs_texture_t *texture, float f, obs_source_t *filter_to)
+{
+	if (filter->builtin_params[SHADER_BUILTIN_PREVIOUS_OUTPUT] || filter->pass_map.num || filter->stages.num ||
+	    filter->render_scale != 1.0f || filter->hold_output || filter->previous_renders > 1 || filter->renders > 1 ||
+	    gs_get_color_space() != GS_CS_SRGB)
+		return false;
+
+	gs_technique_t *tech = gs_effect_get_technique(filter->effect, "DrawLinear");
+	if (!tech)
+		return false;
+
+	const enum gs_color_space preferred_spaces[] = {
+		GS_CS_SRGB,
+		GS_CS_SRGB_16F,
+		GS_CS_709_EXTENDED,
+	};
+	if (obs_source_get_color_space(obs_filter_get_target(filter->context), OBS_COUNTOF(preferred_spaces), preferred_spaces) !=
+	    GS_CS_SRGB)
+		return false;
+
+	shader_filter_set_render_params(filter, texture, f, filter_to);
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	const bool previous_linear = gs_set_linear_srgb(true);
+	gs_enable_framebuffer_srgb(true);
+	size_t passes = gs_technique_begin(tech);
+	for (size_t pass = 0; pass < passes; pass++) {
+		if (gs_technique_begin_pass(tech, pass)) {
+			shader_filter_draw_sprite(filter, texture, filter->total_width, filter->total_height);
+			gs_technique_end_pass(tech);
+		}
+	}
+	gs_technique_end(tech);
+	gs_set_linear_srgb(previous_linear);
+	gs_enable_framebuffer_srgb(previous);
+	shader_filter_release_input_mips(filter);
+	return true;
+}
+
+/* True if the output of an earlier frame is kept at the current size to be drawn again. */
+static bool shader_filter_output_held(const struct shader_filter_data *filter)
+{
+	gs_texture_t *texture = gs_texrender_get_texture(filter->output_texrender);
+	return filter->hold_output && texture && (!filter->stages.num || filter->stage_output) &&
+	       gs_texture_get_width(texture) == (uint32_t)filter->render_width &&
+	       gs_texture_get_height(texture) == (uint32_t)filter->render_height;
+}
+
+/*
+ * True if the kept output can be drawn instead of the shader: the update rate
+ * leaves this frame out, or neither the input nor the uniforms changed since.
+ */
+static bool shader_filter_can_reuse_output(const struct shader_filter_data *filter)
+{
+	if (!shader_filter_output_held(filter))
+		return false;
+	if (shader_filter_decimated(filter) && !filter->update_due)
+		return true;
+	return filter->content_static && filter->content_hash && shader_filter_content_hash(filter) == filter->content_hash;
+}
+
+/*
+ * Hands the leased copies back to the pool once the filter is drawn, so
+ * filters drawn after it in the same frame can use them. A later draw of
+ * this filter in the same frame renders them again.
+ */
+static void shader_filter_release_leases(struct shader_filter_data *filter)
+{
+	if (filter->input_leased) {
+		texrender_pool_release(filter->input_texrender);
+		filter->input_texrender = NULL;
+		filter->input_leased = false;
+		filter->input_rendered = false;
+	}
+	if (filter->output_leased) {
+		texrender_pool_release(filter->output_texrender);
+		filter->output_texrender = NULL;
+		filter->output_leased = false;
+	}
+	for (size_t i = 0; i < OBS_COUNTOF(filter->stage_texrenders); i++) {
+		if (filter->stage_texrenders[i]) {
+			texrender_pool_release(filter->stage_texrenders[i]);
+			filter->stage_texrenders[i] = NULL;
+		}
+	}
+	if (!filter->hold_output)
+		filter->stage_output = NULL;
+	filter->last_render_f = -1.0f;
 }
 
 static void shader_filter_render(void *data, gs_effect_t *effect)
@@ -3554,6 +4688,18 @@ static void shader_filter_render(void *data, gs_effect_t *effect)
 	obs_source_t *filter_to = NULL;
 	if (move_get_transition_filter)
 		f = move_get_transition_filter(filter->context, &filter_to);
+	filter->renders++;
+
+	if (filter->effect && !filter->rendering && shader_filter_can_render_direct(filter)) {
+		filter->rendering = true;
+		bool rendered = render_shader_direct(filter, f, filter_to);
+		filter->rendering = false;
+		if (rendered) {
+			// Nothing was kept in output_texrender to draw again.
+			filter->last_render_f = -1.0f;
+			return;
+		}
+	}
 
 	if (f == filter->last_render_f) {
 		draw_output(filter);
@@ -3566,14 +4712,37 @@ static void shader_filter_render(void *data, gs_effect_t *effect)
 		return;
 	}
 
+	if (f == 0.0f && shader_filter_can_reuse_output(filter)) {
+		draw_output(filter);
+		filter->output_rendered = true;
+		return;
+	}
+
 	get_input_source(filter);
 
 	filter->rendering = true;
-	render_shader(filter, f, filter_to);
+	gs_texture_t *texture = gs_texrender_get_texture(filter->input_texrender);
+	// move-transition draws a filter twice per frame with different values of f, the second draw reuses the input.
+	const bool last_draw = f == 0.0f && filter->previous_renders <= 1;
+	if (texture && render_shader_to_target(filter, texture, f, filter_to)) {
+		// Nothing was kept in output_texrender to draw again.
+		filter->last_render_f = -1.0f;
+		filter->rendering = false;
+		if (last_draw)
+			shader_filter_release_leases(filter);
+		return;
+	}
+	if (texture) {
+		render_shader(filter, texture, f, filter_to);
+		render_stages(filter);
+	}
+	filter->content_hash = texture && filter->content_static && f == 0.0f ? shader_filter_content_hash(filter) : 0;
 	draw_output(filter);
 	if (f == 0.0f)
 		filter->output_rendered = true;
 	filter->rendering = false;
+	if (last_draw)
+		shader_filter_release_leases(filter);
 }
 
 static uint32_t shader_filter_getwidth(void *data)
@@ -3596,6 +4765,8 @@ static void shader_filter_defaults(obs_data_t *settings)
 	obs_data_set_default_string(settings, "shader_text", effect_template_default_image_shader);
 	obs_data_set_default_int(settings, "source_width", 1920);
 	obs_data_set_default_int(settings, "source_height", 1080);
+	obs_data_set_default_double(settings, "render_scale", 1.0);
+	obs_data_set_default_int(settings, "update_interval", 1);
 }
 
 static enum gs_color_space shader_filter_get_color_space(void *data, size_t count, const enum gs_color_space *preferred_spaces)
@@ -3730,10 +4901,12 @@ static void *shader_transition_create(obs_data_t *settings, obs_source_t *source
 	filter->last_from_file = obs_data_get_bool(settings, "from_file");
 	filter->rand_instance_f = (float)((double)rand_interval(0, 10000) / (double)10000);
 	filter->rand_activation_f = (float)((double)rand_interval(0, 10000) / (double)10000);
+	filter->rand_state = os_gettime_ns() ^ (uint64_t)(uintptr_t)filter;
 
 	pthread_mutex_init(&filter->audio_mutex, NULL);
 
 	da_init(filter->stored_param_list);
+	da_init(filter->param_bindings);
 
 	obs_source_update(source, settings);
 
@@ -3785,29 +4958,30 @@ static void shader_transition_video_callback(void *data, gs_texture_t *a, gs_tex
 	const bool previous = gs_framebuffer_srgb_enabled();
 	gs_enable_framebuffer_srgb(true);
 
+	shader_filter_set_effect_params(filter);
+
+	gs_eparam_t **builtins = filter->builtin_params;
 	if (gs_get_color_space() == GS_CS_SRGB) {
-		if (filter->param_image_a != NULL)
-			gs_effect_set_texture(filter->param_image_a, a);
-		if (filter->param_image_b != NULL)
-			gs_effect_set_texture(filter->param_image_b, b);
-		if (filter->param_image != NULL)
-			gs_effect_set_texture(filter->param_image, t < 0.5 ? a : b);
-		if (filter->param_convert_linear)
-			gs_effect_set_bool(filter->param_convert_linear, true);
+		if (builtins[SHADER_BUILTIN_IMAGE_A] != NULL)
+			gs_effect_set_texture(builtins[SHADER_BUILTIN_IMAGE_A], a);
+		if (builtins[SHADER_BUILTIN_IMAGE_B] != NULL)
+			gs_effect_set_texture(builtins[SHADER_BUILTIN_IMAGE_B], b);
+		if (builtins[SHADER_BUILTIN_IMAGE] != NULL)
+			gs_effect_set_texture(builtins[SHADER_BUILTIN_IMAGE], t < 0.5 ? a : b);
+		if (builtins[SHADER_BUILTIN_CONVERT_LINEAR])
+			gs_effect_set_bool(builtins[SHADER_BUILTIN_CONVERT_LINEAR], true);
 	} else {
-		if (filter->param_image_a != NULL)
-			gs_effect_set_texture_srgb(filter->param_image_a, a);
-		if (filter->param_image_b != NULL)
-			gs_effect_set_texture_srgb(filter->param_image_b, b);
-		if (filter->param_image != NULL)
-			gs_effect_set_texture_srgb(filter->param_image, t < 0.5 ? a : b);
-		if (filter->param_convert_linear)
-			gs_effect_set_bool(filter->param_convert_linear, false);
-	}
-	if (filter->param_transition_time != NULL)
-		gs_effect_set_float(filter->param_transition_time, t);
-
-	shader_filter_set_effect_params(filter);
+		if (builtins[SHADER_BUILTIN_IMAGE_A] != NULL)
+			gs_effect_set_texture_srgb(builtins[SHADER_BUILTIN_IMAGE_A], a);
+		if (builtins[SHADER_BUILTIN_IMAGE_B] != NULL)
+			gs_effect_set_texture_srgb(builtins[SHADER_BUILTIN_IMAGE_B], b);
+		if (builtins[SHADER_BUILTIN_IMAGE] != NULL)
+			gs_effect_set_texture_srgb(builtins[SHADER_BUILTIN_IMAGE], t < 0.5 ? a : b);
+		if (builtins[SHADER_BUILTIN_CONVERT_LINEAR])
+			gs_effect_set_bool(builtins[SHADER_BUILTIN_CONVERT_LINEAR], false);
+	}
+	if (builtins[SHADER_BUILTIN_TRANSITION_TIME] != NULL)
+		gs_effect_set_float(builtins[SHADER_BUILTIN_TRANSITION_TIME], t);
 
 	while (gs_effect_loop(filter->effect, "Draw"))
 		gs_draw_sprite(NULL, 0, cx, cy);
@@ -3871,17 +5045,88 @@ struct obs_source_info shader_transition = {
 	.missing_files = shader_filter_missing_files,
 };
 
+/*
+ * Draws the source shader at its render scale into output_texrender and
+ * upscales that, skipping the shader on frames its update rate leaves out
+ * and while nothing it reads changes.
+ * The texrender uses the framebuffer sRGB state of the target so the shader
+ * output reaches it unchanged apart from the upscale.
+ */
+static void shader_source_render_texrender(struct shader_filter_data *filter)
+{
+	const bool linear_srgb = gs_get_linear_srgb();
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(linear_srgb);
+
+	if (!shader_filter_can_reuse_output(filter)) {
+		shader_filter_frame_texrender(&filter->output_texrender, &filter->previous_output_texrender, &filter->output_leased,
+					      false, filter->hold_output, filter->render_width, filter->render_height);
+		gs_texrender_t *render = filter->output_texrender;
+		shader_filter_set_effect_params(filter);
+		gs_blend_state_push();
+		gs_reset_blend_state();
+		gs_enable_blending(false);
+		if (filter->pass_map.num) {
+			shader_filter_draw_passes(filter, NULL, render, filter->render_width, filter->render_height);
+		} else if (gs_texrender_begin(render, filter->render_width, filter->render_height)) {
+			gs_ortho(0.0f, (float)filter->render_width, 0.0f, (float)filter->render_height, -100.0f, 100.0f);
+			while (gs_effect_loop(filter->effect, "Draw"))
+				gs_draw_sprite(NULL, 0, filter->render_width, filter->render_height);
+			gs_texrender_end(render);
+		}
+		gs_blend_state_pop();
+		// Further views in this frame draw the same result again.
+		filter->update_due = false;
+		filter->content_hash = filter->content_static ? shader_filter_content_hash(filter) : 0;
+	}
+
+	gs_texture_t *texture = gs_texrender_get_texture(filter->output_texrender);
+	if (texture && filter->output_effect && filter->param_output_image) {
+		if (linear_srgb)
+			gs_effect_set_texture_srgb(filter->param_output_image, texture);
+		else
+			gs_effect_set_texture(filter->param_output_image, texture);
+		const bool sharpen = filter->render_sharpen && filter->param_output_texel && filter->render_width < filter->width;
+		if (sharpen) {
+			struct vec2 texel;
+			texel.x = 1.0f / filter->render_width;
+			texel.y = 1.0f / filter->render_height;
+			gs_effect_set_vec2(filter->param_output_texel, &texel);
+		}
+		gs_blend_state_push();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+		while (gs_effect_loop(filter->output_effect, sharpen ? "UpscaleSharpen" : "Upscale"))
+			gs_draw_sprite(texture, 0, filter->width, filter->height);
+		gs_blend_state_pop();
+	}
+	// Further views render it again, unless it is held.
+	if (filter->output_leased) {
+		texrender_pool_release(filter->output_texrender);
+		filter->output_texrender = NULL;
+		filter->output_leased = false;
+	}
+
+	gs_enable_framebuffer_srgb(previous);
+}
+
 static void shader_source_render(void *data, gs_effect_t *effect)
 {
 	UNUSED_PARAMETER(effect);
 	struct shader_filter_data *filter = data;
 	if (!filter->effect)
 		return;
+	if (filter->render_width < filter->width || filter->render_height < filter->height || filter->hold_output) {
+		shader_source_render_texrender(filter);
+		return;
+	}
 	shader_filter_set_effect_params(filter);
 	gs_blend_state_push();
 	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
-	while (gs_effect_loop(filter->effect, "Draw")) {
-		gs_draw_sprite(NULL, 0, filter->width, filter->height);
+	if (filter->pass_map.num) {
+		shader_filter_draw_passes(filter, NULL, NULL, filter->width, filter->height);
+	} else {
+		while (gs_effect_loop(filter->effect, "Draw"))
+			gs_draw_sprite(NULL, 0, filter->width, filter->height);
 	}
 	gs_blend_state_pop();
 }
@@ -3926,14 +5171,46 @@ OBS_MODULE_USE_DEFAULT_LOCALE("obs-shaderfilter", "en-US")
 bool obs_module_load(void)
 {
 	blog(LOG_INFO, "[obs-shaderfilter] loaded version %s", PROJECT_VERSION);
+	if (!shader_builtin_table_valid())
+		blog(LOG_ERROR, "[obs-shaderfilter] builtin uniform table has colliding names");
+	pthread_mutex_init(&shared_effects_mutex, NULL);
+	da_init(shared_effects);
+	shader_compile_queue = os_task_queue_create();
+	shader_frame_clock_tick(NULL, 0.0f);
+	obs_add_tick_callback(shader_frame_clock_tick, NULL);
+	shader_watch_init();
 	obs_register_source(&shader_filter);
 	obs_register_source(&shader_transition);
 	obs_register_source(&shader_source);
+	proc_handler_add(obs_get_proc_handler(),
+			 "void shaderfilter_texrender_pool_stats(out int entries, out int created, out int reused, "
+			 "out int destroyed, out int bytes, out int peak_bytes)",
+			 texrender_pool_get_stats, NULL);
 
 	return true;
 }
 
-void obs_module_unload(void) {}
+void obs_module_unload(void)
+{
+	obs_remove_tick_callback(shader_frame_clock_tick, NULL);
+	if (shader_compile_queue) {
+		os_task_queue_destroy(shader_compile_queue);
+		shader_compile_queue = NULL;
+	}
+	shader_watch_free();
+	texrender_pool_free();
+	param_source_texture_free();
+	if (shared_effects.num) {
+		obs_enter_graphics();
+		for (size_t i = 0; i < shared_effects.num; i++) {
+			gs_effect_destroy(shared_effects.array[i].effect);
+			bfree(shared_effects.array[i].text);
+		}
+		obs_leave_graphics();
+	}
+	da_free(shared_effects);
+	pthread_mutex_destroy(&shared_effects_mutex);
+}
 
 void obs_module_post_load()
 {
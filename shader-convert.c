@@ -0,0 +1,1268 @@
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "shader-convert.h"
+
+/*
+ * The converter tokenizes the source once, records every rewrite as an edit
+ * on a token (a replacement text, text inserted before or after it, or a
+ * deletion) and writes the result in a single emit pass. Rules look at the
+ * significant tokens around them instead of re-scanning the text, so the
+ * whole conversion is linear in the size of the shader.
+ */
+
+enum convert_token_kind {
+	CONVERT_SPACE,
+	CONVERT_COMMENT,
+	CONVERT_DIRECTIVE,
+	CONVERT_IDENT,
+	CONVERT_NUMBER,
+	CONVERT_STRING,
+	CONVERT_PUNCT,
+};
+
+struct convert_type {
+	const char *glsl;
+	const char *hlsl;
+	int count;
+	bool scalar;
+};
+
+struct convert_token {
+	enum convert_token_kind kind;
+	const char *start;
+	size_t len;
+	bool newline;
+	bool deleted;
+	bool in_directive;
+	int brace_depth;
+	int paren_depth;
+	size_t match;
+	size_t group_next;
+	size_t line_end;
+	const struct convert_type *type;
+	size_t edit;
+};
+
+/* A rewrite of one token. `copies` re-emits a converted range of tokens before the text. */
+struct convert_edit {
+	const char *text;
+	struct dstr before;
+	struct dstr after;
+	size_t copy_first;
+	size_t copy_last;
+	int copies;
+	const char *copy_sep;
+};
+
+enum convert_name_flags {
+	CONVERT_NAME_USED = 1,
+	CONVERT_NAME_DECLARED = 2,
+	CONVERT_NAME_CALLED = 4,
+	CONVERT_NAME_SCALAR = 8,
+	CONVERT_NAME_MATRIX = 16,
+};
+
+struct convert_symbol {
+	const char *name;
+	size_t len;
+	size_t value;
+};
+
+struct convert_symbols {
+	struct convert_symbol *slots;
+	size_t capacity;
+	size_t num;
+};
+
+struct convert_state {
+	const char *text;
+	DARRAY(struct convert_token) tokens;
+	DARRAY(size_t) sig;
+	DARRAY(struct convert_edit) edits;
+	struct convert_symbols names;
+	struct convert_symbols textures;
+	struct dstr texture_uniforms;
+
+	size_t body_open;
+	const char *ret_name;
+	size_t ret_len;
+	const char *coord_name;
+	size_t coord_len;
+	int uv;
+	const char *time_name;
+};
+
+static const struct convert_type convert_types[] = {
+	{"bool", "bool", 1, false},     {"bvec2", "bool2", 2, false},   {"bvec3", "bool3", 3, false},
+	{"bvec4", "bool4", 4, false},   {"bool2", "bool2", 2, false},   {"bool3", "bool3", 3, false},
+	{"bool4", "bool4", 4, false},   {"int", "int", 1, true},        {"ivec2", "int2", 2, false},
+	{"ivec3", "int3", 3, false},    {"ivec4", "int4", 4, false},    {"int2", "int2", 2, false},
+	{"int3", "int3", 3, false},     {"int4", "int4", 4, false},     {"uint", "uint", 1, true},
+	{"uvec2", "uint2", 2, false},   {"uvec3", "uint3", 3, false},   {"uvec4", "uint4", 4, false},
+	{"uint2", "uint2", 2, false},   {"uint3", "uint3", 3, false},   {"uint4", "uint4", 4, false},
+	{"float", "float", 1, true},    {"vec2", "float2", 2, false},   {"vec3", "float3", 3, false},
+	{"vec4", "float4", 4, false},   {"float2", "float2", 2, false}, {"float3", "float3", 3, false},
+	{"float4", "float4", 4, false}, {"mat2", "mat2", 4, false},     {"mat3", "mat3", 9, false},
+	{"mat4", "mat4", 16, false},
+};
+
+struct convert_rename {
+	const char *from;
+	const char *to;
+	bool call;
+};
+
+static const struct convert_rename convert_renames[] = {
+	{"love_ScreenSize", "uv_size", false},
+	{"u_resolution", "uv_size", false},
+	{"uResolution", "uv_size", false},
+	{"dFdx", "ddx", true},
+	{"dFdy", "ddy", true},
+	{"mix", "lerp", true},
+	{"fract", "frac", true},
+	{"inversesqrt", "rsqrt", true},
+	{"point", "point2", true},
+	{"line", "line2", true},
+};
+
+/* Builtins that return a scalar whatever their arguments are. */
+static const char *const convert_scalar_functions[] = {
+	"length",      "float",        "uint",        "int",          "asfloat",  "asdouble",
+	"asint",       "asuint",       "determinant", "distance",     "dot",      "countbits",
+	"firstbithigh", "firstbitlow", "reversebits",
+};
+
+/* Builtins that return a scalar when their arguments are scalars. */
+static const char *const convert_elementwise_functions[] = {
+	"abs",   "acos",  "asin",     "atan",    "atan2",   "ceil",      "clamp",     "cos",         "cosh",
+	"ddx",   "ddy",   "dFdx",     "dFdy",    "degrees", "exp",       "exp2",      "floor",       "fma",
+	"fmod",  "frac",  "fract",    "frexp",   "fwidth",  "ldexp",     "lerp",      "mix",         "log",
+	"log10", "log2",  "mad",      "max",     "min",     "modf",      "mod",       "mul",         "normalize",
+	"pow",   "radians", "rcp",    "reflect", "refract", "round",     "rsqrt",     "inversesqrt", "saturate",
+	"sign",  "sin",   "sincos",   "sinh",    "smoothstep", "sqrt",   "step",      "tan",         "tanh",
+	"transpose", "trunc",
+};
+
+static const char *const convert_texture_functions[] = {"texture", "texture2D", "texelFetch", "Texel", "textureLod"};
+
+static const char *const convert_time_names[] = {"iTime", "uTime", "u_time", "time"};
+
+static const char *const convert_operators[] = {"==", "!=", "<=", ">=", "+=", "-=", "*=", "/=", "%=",
+						"&=", "|=", "^=", "&&", "||", "++", "--", "<<", ">>"};
+
+#define CONVERT_COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+static bool convert_is_var_char(char ch)
+{
+	return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+}
+
+static bool convert_span_is(const char *span, size_t len, const char *str)
+{
+	return *span == *str && strlen(str) == len && memcmp(span, str, len) == 0;
+}
+
+static uint64_t convert_hash(const char *name, size_t len)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static struct convert_symbol *convert_symbol_slot(struct convert_symbol *slots, size_t capacity, const char *name, size_t len)
+{
+	size_t i = (size_t)convert_hash(name, len) & (capacity - 1);
+	while (slots[i].name && (slots[i].len != len || memcmp(slots[i].name, name, len) != 0))
+		i = (i + 1) & (capacity - 1);
+	return slots + i;
+}
+
+static struct convert_symbol *convert_symbol_find(struct convert_symbols *set, const char *name, size_t len)
+{
+	if (!set->num)
+		return NULL;
+	struct convert_symbol *slot = convert_symbol_slot(set->slots, set->capacity, name, len);
+	return slot->name ? slot : NULL;
+}
+
+static struct convert_symbol *convert_symbol_add(struct convert_symbols *set, const char *name, size_t len, bool *added)
+{
+	if ((set->num + 1) * 2 > set->capacity) {
+		size_t capacity = set->capacity ? set->capacity * 2 : 256;
+		struct convert_symbol *slots = bzalloc(sizeof(struct convert_symbol) * capacity);
+		for (size_t i = 0; i < set->capacity; i++) {
+			if (set->slots[i].name)
+				*convert_symbol_slot(slots, capacity, set->slots[i].name, set->slots[i].len) = set->slots[i];
+		}
+		bfree(set->slots);
+		set->slots = slots;
+		set->capacity = capacity;
+	}
+	struct convert_symbol *slot = convert_symbol_slot(set->slots, set->capacity, name, len);
+	*added = !slot->name;
+	if (!slot->name) {
+		slot->name = name;
+		slot->len = len;
+		set->num++;
+	}
+	return slot;
+}
+
+static size_t convert_name_flags(struct convert_state *s, const char *name)
+{
+	struct convert_symbol *symbol = convert_symbol_find(&s->names, name, strlen(name));
+	return symbol ? symbol->value : 0;
+}
+
+static struct convert_token *convert_sig(struct convert_state *s, size_t i)
+{
+	return i < s->sig.num ? s->tokens.array + s->sig.array[i] : NULL;
+}
+
+static struct convert_edit *convert_edit_raw(struct convert_state *s, size_t raw)
+{
+	struct convert_token *t = s->tokens.array + raw;
+	if (t->edit == SIZE_MAX) {
+		t->edit = s->edits.num;
+		da_push_back_new(s->edits);
+	}
+	return s->edits.array + t->edit;
+}
+
+static struct convert_edit *convert_edit(struct convert_state *s, size_t i)
+{
+	return convert_edit_raw(s, s->sig.array[i]);
+}
+
+static bool convert_is_edited(struct convert_state *s, size_t i)
+{
+	struct convert_token *t = convert_sig(s, i);
+	return t && t->edit != SIZE_MAX && s->edits.array[t->edit].text;
+}
+
+static bool convert_is(struct convert_state *s, size_t i, const char *str)
+{
+	struct convert_token *t = convert_sig(s, i);
+	return t && t->kind != CONVERT_STRING && convert_span_is(t->start, t->len, str);
+}
+
+static bool convert_is_ident(struct convert_state *s, size_t i)
+{
+	struct convert_token *t = convert_sig(s, i);
+	return t && t->kind == CONVERT_IDENT;
+}
+
+static bool convert_is_directive(struct convert_token *t, const char *name)
+{
+	if (t->kind != CONVERT_DIRECTIVE)
+		return false;
+	const char *start = t->start + 1;
+	while (*start == ' ' || *start == '\t')
+		start++;
+	return convert_span_is(start, t->len - (start - t->start), name);
+}
+
+static const struct convert_type *convert_type_of(struct convert_state *s, size_t i)
+{
+	struct convert_token *t = convert_sig(s, i);
+	return t ? t->type : NULL;
+}
+
+static bool convert_in_list(struct convert_token *t, const char *const *list, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (convert_span_is(t->start, t->len, list[i]))
+			return true;
+	}
+	return false;
+}
+
+static void convert_delete(struct convert_state *s, size_t first_sig, size_t last_sig)
+{
+	size_t last = s->sig.array[last_sig];
+	for (size_t i = s->sig.array[first_sig]; i <= last; i++)
+		s->tokens.array[i].deleted = true;
+}
+
+static void convert_tokenize(struct convert_state *s)
+{
+	const char *cur = s->text;
+	bool line_start = true;
+	while (*cur) {
+		struct convert_token *t = da_push_back_new(s->tokens);
+		t->start = cur;
+		t->match = SIZE_MAX;
+		t->group_next = SIZE_MAX;
+		t->line_end = SIZE_MAX;
+		t->edit = SIZE_MAX;
+		char ch = *cur;
+		bool continuation = ch == '\\' && (cur[1] == '\n' || (cur[1] == '\r' && cur[2] == '\n'));
+		if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || continuation) {
+			t->kind = CONVERT_SPACE;
+			while (*cur) {
+				if (*cur == '\\' && cur[1] == '\n') {
+					cur += 2;
+				} else if (*cur == '\\' && cur[1] == '\r' && cur[2] == '\n') {
+					cur += 3;
+				} else if (*cur == '\n') {
+					t->newline = true;
+					line_start = true;
+					cur++;
+				} else if (*cur == ' ' || *cur == '\t' || *cur == '\r') {
+					cur++;
+				} else {
+					break;
+				}
+			}
+		} else if (ch == '/' && cur[1] == '/') {
+			t->kind = CONVERT_COMMENT;
+			while (*cur && *cur != '\n')
+				cur++;
+		} else if (ch == '/' && cur[1] == '*') {
+			t->kind = CONVERT_COMMENT;
+			const char *end = strstr(cur + 2, "*/");
+			cur = end ? end + 2 : cur + strlen(cur);
+		} else {
+			if (ch == '#' && line_start) {
+				t->kind = CONVERT_DIRECTIVE;
+				cur++;
+				while (*cur == ' ' || *cur == '\t')
+					cur++;
+				while (convert_is_var_char(*cur))
+					cur++;
+			} else if ((ch >= '0' && ch <= '9') || (ch == '.' && cur[1] >= '0' && cur[1] <= '9')) {
+				t->kind = CONVERT_NUMBER;
+				bool hex = ch == '0' && (cur[1] == 'x' || cur[1] == 'X');
+				cur++;
+				while (convert_is_var_char(*cur) || *cur == '.' ||
+				       (!hex && (*cur == '+' || *cur == '-') && (cur[-1] == 'e' || cur[-1] == 'E')))
+					cur++;
+			} else if (convert_is_var_char(ch)) {
+				t->kind = CONVERT_IDENT;
+				while (convert_is_var_char(*cur))
+					cur++;
+				for (size_t i = 0; i < CONVERT_COUNT(convert_types); i++) {
+					if (convert_span_is(t->start, cur - t->start, convert_types[i].glsl)) {
+						t->type = convert_types + i;
+						break;
+					}
+				}
+			} else if (ch == '"') {
+				t->kind = CONVERT_STRING;
+				for (cur++; *cur && *cur != '"' && *cur != '\n'; cur++) {
+					if (*cur == '\\' && cur[1])
+						cur++;
+				}
+				if (*cur == '"')
+					cur++;
+			} else {
+				t->kind = CONVERT_PUNCT;
+				cur++;
+				for (size_t i = 0; i < CONVERT_COUNT(convert_operators); i++) {
+					if (ch == convert_operators[i][0] && *cur == convert_operators[i][1]) {
+						cur++;
+						break;
+					}
+				}
+			}
+			line_start = false;
+		}
+		t->len = cur - t->start;
+	}
+}
+
+/* Links every #if, #elif and #else to the next directive of the same group. */
+static void convert_link_directives(struct convert_state *s)
+{
+	DARRAY(size_t) open;
+	da_init(open);
+	for (size_t i = 0; i < s->tokens.num; i++) {
+		struct convert_token *t = s->tokens.array + i;
+		if (t->kind != CONVERT_DIRECTIVE)
+			continue;
+		if (convert_is_directive(t, "if") || convert_is_directive(t, "ifdef") || convert_is_directive(t, "ifndef")) {
+			da_push_back(open, &i);
+		} else if (!open.num) {
+			continue;
+		} else if (convert_is_directive(t, "elif") || convert_is_directive(t, "else")) {
+			s->tokens.array[open.array[open.num - 1]].group_next = i;
+			open.array[open.num - 1] = i;
+		} else if (convert_is_directive(t, "endif")) {
+			s->tokens.array[open.array[open.num - 1]].group_next = i;
+			da_pop_back(open);
+		}
+	}
+	da_free(open);
+}
+
+/* Index of the last raw token on the line of a directive, without the newline. */
+static size_t convert_raw_line_end(struct convert_state *s, size_t i)
+{
+	while (i + 1 < s->tokens.num && !s->tokens.array[i + 1].newline)
+		i++;
+	return i;
+}
+
+static void convert_delete_raw(struct convert_state *s, size_t first, size_t last)
+{
+	for (size_t i = first; i <= last; i++)
+		s->tokens.array[i].deleted = true;
+}
+
+/* Resolves #if 0 and #if 1 blocks, keeping only the branch that is compiled. */
+static void convert_fold_conditionals(struct convert_state *s)
+{
+	for (size_t i = 0; i < s->tokens.num; i++) {
+		struct convert_token *t = s->tokens.array + i;
+		if (t->deleted || !convert_is_directive(t, "if") || t->group_next == SIZE_MAX)
+			continue;
+		size_t value = i + 1;
+		while (value < s->tokens.num && s->tokens.array[value].kind == CONVERT_SPACE && !s->tokens.array[value].newline)
+			value++;
+		size_t rest = value + 1;
+		while (rest < s->tokens.num && !s->tokens.array[rest].newline &&
+		       (s->tokens.array[rest].kind == CONVERT_SPACE || s->tokens.array[rest].kind == CONVERT_COMMENT))
+			rest++;
+		if (value >= s->tokens.num || (rest < s->tokens.num && !s->tokens.array[rest].newline))
+			continue;
+		struct convert_token *v = s->tokens.array + value;
+		bool enabled = convert_span_is(v->start, v->len, "1");
+		if (!enabled && !convert_span_is(v->start, v->len, "0"))
+			continue;
+
+		size_t next = t->group_next;
+		size_t endif = next;
+		while (endif != SIZE_MAX && !convert_is_directive(s->tokens.array + endif, "endif"))
+			endif = s->tokens.array[endif].group_next;
+		if (endif == SIZE_MAX)
+			continue;
+
+		if (enabled) {
+			convert_delete_raw(s, i, value);
+			convert_delete_raw(s, next, convert_raw_line_end(s, endif));
+		} else if (convert_is_directive(s->tokens.array + next, "elif")) {
+			convert_delete_raw(s, i, next - 1);
+			convert_edit_raw(s, next)->text = "#if";
+		} else if (convert_is_directive(s->tokens.array + next, "else")) {
+			convert_delete_raw(s, i, convert_raw_line_end(s, next));
+			convert_delete_raw(s, endif, convert_raw_line_end(s, endif));
+		} else {
+			convert_delete_raw(s, i, convert_raw_line_end(s, endif));
+		}
+	}
+}
+
+/* Collects the significant tokens and matches their brackets. */
+static void convert_index(struct convert_state *s)
+{
+	DARRAY(size_t) open;
+	da_init(open);
+	da_reserve(s->sig, s->tokens.num / 2);
+	size_t directive = SIZE_MAX;
+	int brace_depth = 0;
+	int paren_depth = 0;
+	for (size_t i = 0; i < s->tokens.num; i++) {
+		struct convert_token *t = s->tokens.array + i;
+		if (t->deleted)
+			continue;
+		if (t->kind == CONVERT_SPACE || t->kind == CONVERT_COMMENT) {
+			if (t->newline && directive != SIZE_MAX) {
+				s->tokens.array[s->sig.array[directive]].line_end = s->sig.num - 1;
+				directive = SIZE_MAX;
+			}
+			continue;
+		}
+		size_t index = s->sig.num;
+		da_push_back(s->sig, &i);
+		t = s->tokens.array + i;
+		if (t->kind == CONVERT_DIRECTIVE) {
+			if (directive != SIZE_MAX)
+				s->tokens.array[s->sig.array[directive]].line_end = index - 1;
+			directive = index;
+		}
+		t->in_directive = directive != SIZE_MAX;
+		t->brace_depth = brace_depth;
+		t->paren_depth = paren_depth;
+		if (t->kind != CONVERT_PUNCT)
+			continue;
+		char ch = *t->start;
+		if (ch == '(' || ch == '[' || ch == '{') {
+			da_push_back(open, &index);
+			if (ch == '{')
+				brace_depth++;
+			else
+				paren_depth++;
+		} else if ((ch == ')' || ch == ']' || ch == '}') && open.num) {
+			size_t opener = open.array[open.num - 1];
+			char expected = ch == ')' ? '(' : ch == ']' ? '[' : '{';
+			struct convert_token *o = s->tokens.array + s->sig.array[opener];
+			if (*o->start != expected)
+				continue;
+			da_pop_back(open);
+			o->match = index;
+			t->match = opener;
+			if (ch == '}')
+				brace_depth--;
+			else
+				paren_depth--;
+			t->brace_depth = brace_depth;
+			t->paren_depth = paren_depth;
+		}
+	}
+	if (directive != SIZE_MAX)
+		s->tokens.array[s->sig.array[directive]].line_end = s->sig.num - 1;
+	da_free(open);
+}
+
+static void convert_collect_names(struct convert_state *s)
+{
+	for (size_t i = 0; i < s->sig.num; i++) {
+		struct convert_token *t = convert_sig(s, i);
+		if (t->kind != CONVERT_IDENT)
+			continue;
+		bool added;
+		struct convert_symbol *symbol = convert_symbol_add(&s->names, t->start, t->len, &added);
+		if (added)
+			symbol->value = 0;
+		symbol->value |= CONVERT_NAME_USED;
+		if (convert_is(s, i + 1, "("))
+			symbol->value |= CONVERT_NAME_CALLED;
+		const struct convert_type *type = convert_type_of(s, i - 1);
+		if (type) {
+			symbol->value |= CONVERT_NAME_DECLARED;
+			if (type->scalar)
+				symbol->value |= CONVERT_NAME_SCALAR;
+			if (strncmp(type->glsl, "mat", 3) == 0)
+				symbol->value |= CONVERT_NAME_MATRIX;
+		}
+		struct convert_token *number = convert_sig(s, i + 1);
+		if (i > 0 && convert_is_directive(convert_sig(s, i - 1), "define") && number && number->kind == CONVERT_NUMBER &&
+		    number->in_directive)
+			symbol->value |= CONVERT_NAME_SCALAR;
+	}
+	for (size_t i = 0; i < CONVERT_COUNT(convert_time_names); i++) {
+		if (convert_name_flags(s, convert_time_names[i]) || i == CONVERT_COUNT(convert_time_names) - 1) {
+			s->time_name = convert_time_names[i];
+			break;
+		}
+	}
+}
+
+static size_t convert_statement_end(struct convert_state *s, size_t i)
+{
+	for (; i < s->sig.num; i++) {
+		struct convert_token *t = convert_sig(s, i);
+		if (t->kind != CONVERT_PUNCT)
+			continue;
+		if (*t->start == ';')
+			return i;
+		if (*t->start == '}')
+			return SIZE_MAX;
+		if ((*t->start == '(' || *t->start == '[' || *t->start == '{') && t->match != SIZE_MAX)
+			i = t->match;
+	}
+	return SIZE_MAX;
+}
+
+/* Finds the entry point, replaces its signature and picks the output color and coordinate names. */
+static bool convert_entry_point(struct convert_state *s)
+{
+	size_t image = SIZE_MAX;
+	size_t plain = SIZE_MAX;
+	size_t love = SIZE_MAX;
+	for (size_t i = 1; i + 2 < s->sig.num; i++) {
+		if (!convert_is(s, i + 1, "("))
+			continue;
+		if (image == SIZE_MAX && convert_is(s, i, "mainImage") && convert_is(s, i - 1, "void") &&
+		    convert_is(s, i + 2, "out") && convert_is(s, i + 3, "vec4") && convert_is_ident(s, i + 4))
+			image = i - 1;
+		else if (plain == SIZE_MAX && convert_is(s, i, "main") && convert_is(s, i - 1, "void") && convert_is(s, i + 2, ")"))
+			plain = i - 1;
+		else if (love == SIZE_MAX && convert_is(s, i, "effect") && convert_is(s, i - 1, "vec4") &&
+			 convert_is(s, i + 2, "vec4") && convert_is_ident(s, i + 3))
+			love = i - 1;
+	}
+	size_t first = image != SIZE_MAX ? image : plain != SIZE_MAX ? plain : love;
+	if (first == SIZE_MAX)
+		return false;
+	size_t close = convert_sig(s, first + 2)->match;
+	if (close == SIZE_MAX)
+		return false;
+
+	if (first == plain) {
+		if (convert_name_flags(s, "position") & CONVERT_NAME_DECLARED) {
+			s->uv = 1;
+			s->coord_name = "position";
+		} else if (convert_name_flags(s, "pos") & CONVERT_NAME_DECLARED) {
+			s->uv = 1;
+			s->coord_name = "pos";
+		} else if (convert_name_flags(s, "fNormal")) {
+			s->uv = 2;
+			s->coord_name = "fNormal";
+		} else {
+			s->coord_name = "gl_FragCoord";
+		}
+		s->coord_len = strlen(s->coord_name);
+
+		s->ret_name = "gl_FragColor";
+		s->ret_len = strlen(s->ret_name);
+		for (size_t i = 0; i + 2 < s->sig.num; i++) {
+			if (!convert_is(s, i, "out") || !convert_is(s, i + 1, "vec4") || !convert_is_ident(s, i + 2))
+				continue;
+			struct convert_token *name = convert_sig(s, i + 2);
+			s->ret_name = name->start;
+			s->ret_len = name->len;
+			if (convert_is(s, i + 3, ";"))
+				convert_delete(s, i, i + 3);
+			break;
+		}
+	} else {
+		struct convert_token *name = convert_sig(s, first + (first == image ? 5 : 4));
+		s->ret_name = name->start;
+		s->ret_len = name->len;
+		if (first == love)
+			s->uv = 1;
+
+		size_t comma = SIZE_MAX;
+		for (size_t i = first + 3; i < close; i++) {
+			struct convert_token *t = convert_sig(s, i);
+			if (t->match != SIZE_MAX && t->match > i) {
+				i = t->match;
+			} else if (convert_is(s, i, ",")) {
+				comma = i;
+				break;
+			}
+		}
+		if (comma == SIZE_MAX)
+			return false;
+		size_t coord = SIZE_MAX;
+		for (size_t i = comma + 1; i + 1 < close; i++) {
+			if (convert_is(s, i, "vec2") && convert_is_ident(s, i + 1)) {
+				coord = i + 1;
+				break;
+			}
+		}
+		if (coord == SIZE_MAX) {
+			coord = comma + 1;
+			while (convert_is(s, coord, "in") || convert_is(s, coord, "const"))
+				coord++;
+		}
+		if (coord >= close || !convert_is_ident(s, coord))
+			return false;
+		s->coord_name = convert_sig(s, coord)->start;
+		s->coord_len = convert_sig(s, coord)->len;
+	}
+
+	// The new signature goes in front of whatever follows the old one, so no rule rewrites it.
+	size_t after = s->sig.array[close] + 1;
+	if (after >= s->tokens.num)
+		return false;
+	convert_delete(s, first, close);
+	dstr_cat(&convert_edit_raw(s, after)->before, "float4 mainImage(VertData v_in) : TARGET");
+	s->body_open = convert_is(s, close + 1, "{") ? close + 1 : SIZE_MAX;
+	return true;
+}
+
+/* Returns the index of the assignment operator if token `i` assigns the output color. */
+static size_t convert_color_assignment(struct convert_state *s, size_t i, bool *part, bool *alpha)
+{
+	struct convert_token *t = convert_sig(s, i);
+	if (t->kind != CONVERT_IDENT || t->len != s->ret_len || memcmp(t->start, s->ret_name, t->len) != 0 ||
+	    convert_is(s, i - 1, "."))
+		return SIZE_MAX;
+	*part = false;
+	*alpha = true;
+	size_t op = i + 1;
+	if (convert_is(s, op, ".") && convert_is_ident(s, op + 1)) {
+		struct convert_token *swizzle = convert_sig(s, op + 1);
+		*part = true;
+		*alpha = memchr(swizzle->start, 'a', swizzle->len) || memchr(swizzle->start, 'A', swizzle->len) ||
+			 memchr(swizzle->start, 'w', swizzle->len) || memchr(swizzle->start, 'W', swizzle->len);
+		op += 2;
+	}
+	if (convert_is(s, op, "=") || convert_is(s, op, "*=") || convert_is(s, op, "/=") || convert_is(s, op, "+=") ||
+	    convert_is(s, op, "-="))
+		return op;
+	return SIZE_MAX;
+}
+
+/* Turns the writes to the output color of the entry point into a return. */
+static void convert_return(struct convert_state *s)
+{
+	if (s->body_open == SIZE_MAX)
+		return;
+	size_t body_close = convert_sig(s, s->body_open)->match;
+	if (body_close == SIZE_MAX)
+		return;
+
+	size_t count = 0;
+	size_t last = SIZE_MAX;
+	bool part = false;
+	bool alpha = true;
+	for (size_t i = s->body_open + 1; i < body_close; i++) {
+		if (convert_color_assignment(s, i, &part, &alpha) == SIZE_MAX)
+			continue;
+		count++;
+		last = i;
+	}
+	if (!count)
+		return;
+
+	size_t op = convert_color_assignment(s, last, &part, &alpha);
+	size_t end = convert_statement_end(s, op);
+	if (count == 1) {
+		convert_edit(s, last)->text = alpha ? "return" : "return float4(";
+		convert_delete_raw(s, s->sig.array[last] + 1, s->sig.array[op]);
+		if (!alpha && end != SIZE_MAX)
+			dstr_cat(&convert_edit(s, end)->before, ",1.0)");
+		return;
+	}
+
+	struct convert_edit *open = convert_edit(s, s->body_open);
+	dstr_cat(&open->after, "\n\tfloat4 ");
+	dstr_ncat(&open->after, s->ret_name, s->ret_len);
+	dstr_cat(&open->after, " = float4(0.0,0.0,0.0,1.0);\n");
+
+	if (part || !convert_is(s, op, "=")) {
+		if (end == SIZE_MAX)
+			return;
+		struct convert_edit *semicolon = convert_edit(s, end);
+		dstr_cat(&semicolon->after, "\n\treturn ");
+		dstr_ncat(&semicolon->after, s->ret_name, s->ret_len);
+		dstr_cat(&semicolon->after, ";");
+	} else {
+		convert_edit(s, last)->text = "return";
+		convert_delete_raw(s, s->sig.array[last] + 1, s->sig.array[op]);
+	}
+}
+
+static bool convert_is_coord(struct convert_state *s, struct convert_token *t)
+{
+	return (t->len == s->coord_len && memcmp(t->start, s->coord_name, t->len) == 0) ||
+	       convert_span_is(t->start, t->len, "fragCoord") ||
+	       (s->uv == 0 && convert_span_is(t->start, t->len, "gl_FragCoord"));
+}
+
+static void convert_coord(struct convert_state *s, size_t i)
+{
+	struct convert_edit *t = convert_edit(s, i);
+	if (s->uv == 1) {
+		t->text = "v_in.uv";
+	} else if (s->uv == 2) {
+		if (convert_is(s, i + 1, ".") && convert_is(s, i + 2, "xy")) {
+			t->text = "v_in.uv";
+			convert_delete(s, i + 1, i + 2);
+		} else {
+			t->text = "float3(v_in.uv,0.0)";
+		}
+	} else {
+		size_t j = i + 1;
+		if (convert_is(s, j, ".") && convert_is(s, j + 1, "xy"))
+			j += 2;
+		if (convert_is(s, j, "/") && convert_is(s, j + 1, "iResolution") && convert_is(s, j + 2, ".") &&
+		    convert_is(s, j + 3, "xy")) {
+			t->text = "v_in.uv";
+			convert_delete(s, i + 1, j + 3);
+		} else {
+			t->text = "(v_in.uv * uv_size)";
+		}
+	}
+}
+
+static void convert_resolution(struct convert_state *s, size_t i)
+{
+	struct convert_edit *t = convert_edit(s, i);
+	if (!convert_is(s, i + 1, ".") || !convert_is_ident(s, i + 2)) {
+		t->text = "float4(uv_size,uv_pixel_interval)";
+	} else if (convert_is(s, i + 2, "xyz")) {
+		t->text = "float3(uv_size,0.0)";
+		convert_delete(s, i + 1, i + 2);
+	} else if (convert_is(s, i + 2, "xy")) {
+		t->text = "uv_size";
+		convert_delete(s, i + 1, i + 2);
+	} else if (convert_is(s, i + 2, "x") || convert_is(s, i + 2, "y")) {
+		t->text = "uv_size";
+	} else {
+		t->text = "float4(uv_size,uv_pixel_interval)";
+	}
+}
+
+static bool convert_is_builtin_name(struct convert_state *s, size_t i)
+{
+	struct convert_token *t = convert_sig(s, i);
+	if (!t || t->kind != CONVERT_IDENT)
+		return false;
+	return convert_span_is(t->start, t->len, s->time_name) || convert_span_is(t->start, t->len, "elapsed_time") ||
+	       convert_span_is(t->start, t->len, "uv_size") || convert_span_is(t->start, t->len, "love_ScreenSize") ||
+	       convert_span_is(t->start, t->len, "u_resolution") || convert_span_is(t->start, t->len, "uResolution") ||
+	       convert_span_is(t->start, t->len, "iResolution");
+}
+
+static void convert_texture(struct convert_state *s, size_t i)
+{
+	struct convert_token *name = convert_sig(s, i + 2);
+	bool added;
+	struct convert_symbol *texture = convert_symbol_add(&s->textures, name->start, name->len, &added);
+	if (added) {
+		texture->value = s->textures.num - 1;
+		if (texture->value) {
+			dstr_cat(&s->texture_uniforms, "uniform texture2d ");
+			dstr_ncat(&s->texture_uniforms, name->start, name->len);
+			dstr_cat(&s->texture_uniforms, ";\n");
+		}
+	}
+	if (texture->value) {
+		convert_edit(s, i)->text = "";
+		convert_edit(s, i + 1)->text = "";
+		dstr_cat(&convert_edit(s, i + 2)->after, ".Sample(textureSampler");
+	} else {
+		convert_edit(s, i)->text = "image.Sample";
+		convert_edit(s, i + 2)->text = "textureSampler";
+	}
+}
+
+/*
+ * Checks the arguments of a constructor. Returns true if every argument is
+ * built from numbers and scalars only, and sets `single` if there is one.
+ */
+static bool convert_simple_args(struct convert_state *s, size_t open, size_t close, bool *single)
+{
+	*single = true;
+	for (size_t i = open + 1; i < close; i++) {
+		struct convert_token *t = convert_sig(s, i);
+		if (t->kind == CONVERT_PUNCT) {
+			if (*t->start == ',' && t->paren_depth == convert_sig(s, open)->paren_depth + 1)
+				*single = false;
+			continue;
+		}
+		if (t->kind != CONVERT_IDENT)
+			continue;
+		size_t flags = 0;
+		struct convert_symbol *symbol = convert_symbol_find(&s->names, t->start, t->len);
+		if (symbol)
+			flags = symbol->value;
+		if (convert_is(s, i + 1, "(")) {
+			struct convert_token *call = convert_sig(s, i + 1);
+			if (convert_in_list(t, convert_scalar_functions, CONVERT_COUNT(convert_scalar_functions)) ||
+			    (flags & CONVERT_NAME_SCALAR)) {
+				if (call->match == SIZE_MAX)
+					return false;
+				i = call->match;
+			} else if (!convert_in_list(t, convert_elementwise_functions, CONVERT_COUNT(convert_elementwise_functions))) {
+				return false;
+			}
+		} else if (convert_is(s, i + 1, ".")) {
+			struct convert_token *swizzle = convert_sig(s, i + 2);
+			if (!swizzle || swizzle->kind != CONVERT_IDENT || swizzle->len != 1)
+				return false;
+			i += 2;
+		} else if (!(flags & CONVERT_NAME_SCALAR)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Global declarations become uniforms, one per declaration. */
+static void convert_global_declaration(struct convert_state *s, size_t i)
+{
+	struct convert_token *t = convert_sig(s, i);
+	const struct convert_type *type = convert_type_of(s, i);
+	if (!type || t->brace_depth || t->paren_depth || t->in_directive || !convert_is_ident(s, i + 1))
+		return;
+	struct convert_token *prev = convert_sig(s, i - 1);
+	bool qualified = convert_is(s, i - 1, "uniform") || convert_is(s, i - 1, "const");
+	if (!qualified && prev && !prev->in_directive &&
+	    (prev->kind == CONVERT_IDENT || prev->kind == CONVERT_NUMBER || convert_is(s, i - 1, "(") || convert_is(s, i - 1, ",")))
+		return;
+
+	size_t next = i + 2;
+	while (convert_is(s, next, ",") && convert_is_ident(s, next + 1)) {
+		struct convert_edit *comma = convert_edit(s, next);
+		comma->text = ";";
+		dstr_cat(&comma->after, convert_is(s, i - 1, "const") ? "\nconst " : "\nuniform ");
+		dstr_cat(&comma->after, type->hlsl);
+		dstr_cat(&comma->after, " ");
+		next += 2;
+	}
+	if (!qualified && (convert_is(s, next, "=") || convert_is(s, next, ";")))
+		dstr_cat(&convert_edit(s, i)->before, "uniform ");
+}
+
+static void convert_constructor(struct convert_state *s, size_t i)
+{
+	const struct convert_type *type = convert_type_of(s, i);
+	if (!type || !convert_is(s, i + 1, "("))
+		return;
+	struct convert_token *t = convert_sig(s, i);
+	struct convert_token *open = convert_sig(s, i + 1);
+	if (open->match == SIZE_MAX)
+		return;
+	size_t close = open->match;
+	bool single;
+	if (!convert_simple_args(s, i + 1, close, &single))
+		return;
+
+	// Constant initializers of globals are written as initializer lists.
+	const struct convert_type *declared = convert_type_of(s, i - 3);
+	if (!t->brace_depth && convert_is(s, i - 1, "=") && convert_is_ident(s, i - 2) && declared &&
+	    strcmp(declared->hlsl, type->hlsl) == 0) {
+		convert_edit(s, i)->text = "";
+		convert_edit(s, i + 1)->text = type->count > 1 ? "{" : "";
+		convert_edit(s, close)->text = type->count > 1 ? "}" : "";
+	}
+
+	if (type->count > 1 && single && close > i + 2) {
+		struct convert_edit *end = convert_edit(s, close);
+		end->copy_first = s->sig.array[i + 1] + 1;
+		end->copy_last = s->sig.array[close] - 1;
+		end->copies = type->count - 1;
+		end->copy_sep = ",";
+	}
+}
+
+static void convert_atan(struct convert_state *s, size_t i)
+{
+	struct convert_token *open = convert_sig(s, i + 1);
+	if (!convert_is(s, i + 1, "(") || open->match == SIZE_MAX)
+		return;
+	size_t divide = SIZE_MAX;
+	for (size_t j = i + 2; j < open->match; j++) {
+		struct convert_token *t = convert_sig(s, j);
+		if (t->kind != CONVERT_PUNCT)
+			continue;
+		if ((*t->start == '(' || *t->start == '[') && t->match != SIZE_MAX) {
+			j = t->match;
+		} else if (*t->start == ',') {
+			convert_edit(s, i)->text = "atan2";
+			return;
+		} else if (t->len == 1 && *t->start == '/' && divide == SIZE_MAX) {
+			divide = j;
+		}
+	}
+	if (divide != SIZE_MAX) {
+		convert_edit(s, i)->text = "atan2";
+		convert_edit(s, divide)->text = ",";
+	}
+}
+
+/* First token of the operand that ends at token `i`. */
+static size_t convert_operand_start(struct convert_state *s, size_t i)
+{
+	while (i < s->sig.num) {
+		struct convert_token *t = convert_sig(s, i);
+		if ((convert_is(s, i, ")") || convert_is(s, i, "]")) && t->match != SIZE_MAX) {
+			i = t->match;
+			if (convert_is_ident(s, i - 1) || convert_is(s, i - 1, "]") || convert_is(s, i - 1, ")")) {
+				i--;
+				continue;
+			}
+		} else if (t->kind != CONVERT_IDENT && t->kind != CONVERT_NUMBER) {
+			return SIZE_MAX;
+		}
+		if (!convert_is(s, i - 1, ".") || i < 2)
+			return i;
+		i -= 2;
+	}
+	return SIZE_MAX;
+}
+
+/* Last token of the operand that starts at token `i`. */
+static size_t convert_operand_end(struct convert_state *s, size_t i)
+{
+	if (convert_is(s, i, "-") || convert_is(s, i, "+"))
+		i++;
+	struct convert_token *t = convert_sig(s, i);
+	if (!t)
+		return SIZE_MAX;
+	if (convert_is(s, i, "(")) {
+		i = t->match;
+	} else if (t->kind == CONVERT_IDENT && convert_is(s, i + 1, "(")) {
+		i = convert_sig(s, i + 1)->match;
+	} else if (t->kind != CONVERT_IDENT && t->kind != CONVERT_NUMBER) {
+		return SIZE_MAX;
+	}
+	while (i < s->sig.num) {
+		if (convert_is(s, i + 1, ".") && convert_is_ident(s, i + 2)) {
+			i += 2;
+			if (convert_is(s, i + 1, "("))
+				i = convert_sig(s, i + 1)->match;
+		} else if (convert_is(s, i + 1, "[")) {
+			i = convert_sig(s, i + 1)->match;
+		} else {
+			break;
+		}
+	}
+	return i;
+}
+
+/* GLSL multiplies matrices with `*`, HLSL needs mul(). */
+static void convert_mat_mul(struct convert_state *s, size_t i)
+{
+	struct convert_token *t = convert_sig(s, i);
+	const struct convert_type *type = convert_type_of(s, i);
+	bool constructor = type && strncmp(type->glsl, "mat", 3) == 0 && convert_is(s, i + 1, "(");
+	size_t last = i;
+	if (constructor) {
+		last = convert_sig(s, i + 1)->match;
+	} else {
+		struct convert_symbol *symbol = convert_symbol_find(&s->names, t->start, t->len);
+		if (!symbol || !(symbol->value & CONVERT_NAME_MATRIX) || convert_type_of(s, i - 1) || convert_is(s, i + 1, "[") ||
+		    convert_is(s, i + 1, "."))
+			return;
+		if (convert_is(s, i + 1, "("))
+			last = convert_sig(s, i + 1)->match;
+	}
+	if (last == SIZE_MAX)
+		return;
+
+	if (convert_is(s, last + 1, "*") && !convert_is_edited(s, last + 1)) {
+		size_t end = convert_operand_end(s, last + 2);
+		if (end == SIZE_MAX)
+			return;
+		dstr_cat(&convert_edit(s, i)->before, "mul(");
+		convert_edit(s, last + 1)->text = ",";
+		dstr_cat(&convert_edit(s, end)->after, ")");
+		return;
+	}
+
+	if (convert_is(s, i - 1, "*=")) {
+		size_t start = convert_operand_start(s, i - 2);
+		size_t end = convert_statement_end(s, last);
+		if (start == SIZE_MAX || end == SIZE_MAX)
+			return;
+		struct convert_edit *star = convert_edit(s, i - 1);
+		star->text = "";
+		dstr_cat(&star->before, "= mul(");
+		star->copy_first = s->sig.array[start];
+		star->copy_last = s->sig.array[i - 2];
+		star->copies = 1;
+		star->copy_sep = "";
+		dstr_cat(&star->after, ",");
+		dstr_cat(&convert_edit(s, end)->before, ")");
+	} else if (convert_is(s, i - 1, "*") && !convert_is_edited(s, i - 1)) {
+		size_t start = convert_operand_start(s, i - 2);
+		if (start == SIZE_MAX)
+			return;
+		dstr_cat(&convert_edit(s, start)->before, "mul(");
+		convert_edit(s, i - 1)->text = ",";
+		dstr_cat(&convert_edit(s, last)->after, ")");
+	}
+}
+
+static void convert_directive(struct convert_state *s, size_t i)
+{
+	struct convert_token *t = convert_sig(s, i);
+	if (convert_is_directive(t, "version")) {
+		dstr_cat(&convert_edit(s, i)->before, "//");
+	} else if (convert_is_directive(t, "if") && t->line_end == i + 4 && convert_is(s, i + 1, "defined") &&
+		   convert_is(s, i + 2, "(") && convert_is_ident(s, i + 3) && convert_is(s, i + 4, ")")) {
+		convert_edit(s, i)->text = "#ifdef";
+		convert_edit(s, i + 1)->text = "";
+		convert_edit(s, i + 2)->text = "";
+		convert_edit(s, i + 4)->text = "";
+	}
+}
+
+static void convert_ident(struct convert_state *s, size_t i)
+{
+	struct convert_token *t = convert_sig(s, i);
+	if (convert_is(s, i - 1, "."))
+		return;
+	bool call = convert_is(s, i + 1, "(");
+
+	if (convert_is_coord(s, t)) {
+		convert_coord(s, i);
+		return;
+	}
+	if (convert_is(s, i, "iResolution")) {
+		convert_resolution(s, i);
+		return;
+	}
+	if (convert_is(s, i, "iDate") && convert_is(s, i + 1, ".") && convert_is(s, i + 2, "w")) {
+		convert_edit(s, i)->text = "local_time";
+		convert_delete(s, i + 1, i + 2);
+		return;
+	}
+	if (convert_span_is(t->start, t->len, s->time_name)) {
+		convert_edit(s, i)->text = "elapsed_time";
+		return;
+	}
+	if (convert_is(s, i, "uniform") && convert_type_of(s, i + 1) && convert_is_builtin_name(s, i + 2) &&
+	    convert_is(s, i + 3, ";")) {
+		convert_delete(s, i, i + 3);
+		return;
+	}
+	if ((convert_is(s, i, "varying") || convert_is(s, i, "precision")) && !t->in_directive) {
+		dstr_cat(&convert_edit(s, i)->before, "//");
+		return;
+	}
+	if (convert_is(s, i, "extern") && (convert_type_of(s, i + 1) || convert_is(s, i + 1, "number"))) {
+		convert_edit(s, i)->text = "uniform";
+		return;
+	}
+	if (convert_is(s, i, "number") && convert_is_ident(s, i + 1)) {
+		convert_edit(s, i)->text = "float";
+		return;
+	}
+	for (size_t j = 0; j < CONVERT_COUNT(convert_renames); j++) {
+		if ((call || !convert_renames[j].call) && convert_span_is(t->start, t->len, convert_renames[j].from)) {
+			convert_edit(s, i)->text = convert_renames[j].to;
+			return;
+		}
+	}
+	if (call && convert_in_list(t, convert_texture_functions, CONVERT_COUNT(convert_texture_functions)) &&
+	    convert_is_ident(s, i + 2)) {
+		convert_texture(s, i);
+		return;
+	}
+	if (call && convert_is(s, i, "textureSize") && convert_is_ident(s, i + 2) && convert_is(s, i + 3, ",") &&
+	    convert_is(s, i + 4, "0") && convert_is(s, i + 5, ")")) {
+		convert_edit(s, i)->text = "uv_size";
+		convert_delete(s, i + 1, i + 5);
+		return;
+	}
+	if (call && convert_is(s, i, "acos") && convert_is(s, i + 2, "-") && convert_is(s, i + 4, ")") &&
+	    (convert_is(s, i + 3, "1.0") || convert_is(s, i + 3, "1.") || convert_is(s, i + 3, "1"))) {
+		convert_edit(s, i)->text = "3.14159265359";
+		convert_delete(s, i + 1, i + 4);
+		return;
+	}
+	if (call && convert_is(s, i, "atan")) {
+		convert_atan(s, i);
+		return;
+	}
+
+	const struct convert_type *type = convert_type_of(s, i);
+	if (type && strcmp(type->glsl, type->hlsl) != 0)
+		convert_edit(s, i)->text = type->hlsl;
+	convert_global_declaration(s, i);
+	convert_constructor(s, i);
+	convert_mat_mul(s, i);
+}
+
+static void convert_emit(struct convert_state *s, struct dstr *out, size_t first, size_t last, bool copy)
+{
+	for (size_t i = first; i <= last && i < s->tokens.num; i++) {
+		struct convert_token *t = s->tokens.array + i;
+		if (t->deleted || (copy && t->kind == CONVERT_COMMENT))
+			continue;
+		if (t->edit == SIZE_MAX) {
+			dstr_ncat(out, t->start, t->len);
+			continue;
+		}
+		struct convert_edit *edit = s->edits.array + t->edit;
+		dstr_cat_dstr(out, &edit->before);
+		for (int c = 0; c < edit->copies; c++) {
+			dstr_cat(out, edit->copy_sep);
+			convert_emit(s, out, edit->copy_first, edit->copy_last, true);
+		}
+		if (edit->text)
+			dstr_cat(out, edit->text);
+		else
+			dstr_ncat(out, t->start, t->len);
+		dstr_cat_dstr(out, &edit->after);
+	}
+}
+
+static void convert_header(struct convert_state *s, struct dstr *header)
+{
+	static const char *const defines[][2] = {
+		{"mat2", "#define mat2 float2x2\n"},
+		{"mat3", "#define mat3 float3x3\n"},
+		{"mat4", "#define mat4 float4x4\n"},
+		{"mod", "#define mod(x,y) ((x) - (y) * floor((x) / (y)))\n"},
+		{"lessThan", "#define lessThan(a,b) ((a) < (b))\n"},
+		{"greaterThan", "#define greaterThan(a,b) ((a) > (b))\n"},
+	};
+	static const char *const uniforms[][2] = {
+		{"iMouse",
+		 "uniform float4 iMouse<\nstring widget_type = \"slider\";\nfloat minimum=0.0;\nfloat maximum=1000.0;\nfloat step=1.0;\n>;\n"},
+		{"iFrame", "uniform float iFrame;\n"},
+		{"iSampleRate", "uniform float iSampleRate;\n"},
+		{"iTimeDelta", "uniform float iTimeDelta;\n"},
+	};
+
+	bool used = false;
+	dstr_copy(header, "#ifndef OPENGL\n");
+	for (size_t i = 0; i < CONVERT_COUNT(defines); i++) {
+		size_t flags = convert_name_flags(s, defines[i][0]);
+		if ((flags & CONVERT_NAME_USED) && (i < 3 || (flags & CONVERT_NAME_CALLED))) {
+			dstr_cat(header, defines[i][1]);
+			used = true;
+		}
+	}
+	dstr_cat(header, "#endif\n");
+	for (size_t i = 0; i < CONVERT_COUNT(uniforms); i++) {
+		size_t flags = convert_name_flags(s, uniforms[i][0]);
+		if ((flags & CONVERT_NAME_USED) && !(flags & CONVERT_NAME_DECLARED)) {
+			dstr_cat(header, uniforms[i][1]);
+			used = true;
+		}
+	}
+	if (s->texture_uniforms.len) {
+		dstr_cat_dstr(header, &s->texture_uniforms);
+		used = true;
+	}
+	if (!used)
+		dstr_free(header);
+}
+
+char *shader_convert_glsl(const char *glsl)
+{
+	if (!glsl || !*glsl)
+		return NULL;
+
+	struct convert_state s = {0};
+	s.text = glsl;
+	da_init(s.tokens);
+	da_init(s.sig);
+	da_init(s.edits);
+	da_reserve(s.tokens, strlen(glsl) / 3);
+	s.body_open = SIZE_MAX;
+
+	convert_tokenize(&s);
+	convert_link_directives(&s);
+	convert_fold_conditionals(&s);
+	convert_index(&s);
+	convert_collect_names(&s);
+
+	char *result = NULL;
+	if (convert_entry_point(&s)) {
+		convert_return(&s);
+		for (size_t i = 0; i < s.sig.num; i++) {
+			struct convert_token *t = convert_sig(&s, i);
+			if (t->deleted)
+				continue;
+			if (t->kind == CONVERT_DIRECTIVE)
+				convert_directive(&s, i);
+			else if (t->kind == CONVERT_IDENT)
+				convert_ident(&s, i);
+		}
+
+		struct dstr out = {0};
+		convert_header(&s, &out);
+		dstr_reserve(&out, out.len + strlen(glsl) + strlen(glsl) / 4 + 1);
+		convert_emit(&s, &out, 0, s.tokens.num - 1, false);
+		result = out.array;
+	}
+
+	for (size_t i = 0; i < s.edits.num; i++) {
+		dstr_free(&s.edits.array[i].before);
+		dstr_free(&s.edits.array[i].after);
+	}
+	da_free(s.edits);
+	da_free(s.tokens);
+	da_free(s.sig);
+	bfree(s.names.slots);
+	bfree(s.textures.slots);
+	dstr_free(&s.texture_uniforms);
+	return result;
+}
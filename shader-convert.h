@@ -0,0 +1,8 @@
+#pragma once
+
+/*
+ * Converts GLSL, Shadertoy or LÖVE shader text to the HLSL dialect of the
+ * shader filter. Returns NULL if no entry point is found, otherwise a string
+ * the caller frees with bfree.
+ */
+char *shader_convert_glsl(const char *glsl);
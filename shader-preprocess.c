@@ -0,0 +1,154 @@
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <string.h>
+
+#include "shader-preprocess.h"
+
+/*
+ * #include preprocessing runs in two passes. The first reads every file
+ * once and records the output as spans into those buffers, merging spans
+ * that are contiguous so plain runs of lines stay a single span. The second
+ * copies the spans into one allocation of the exact total size.
+ */
+struct shader_span {
+	const char *text;
+	size_t len;
+};
+
+struct shader_preprocessor {
+	DARRAY(struct shader_span) spans;
+	DARRAY(char *) buffers; /* file contents and error lines the spans point into */
+	shader_path_array_t *visited;
+};
+
+static void shader_preprocessor_emit(struct shader_preprocessor *pp, const char *text, size_t len)
+{
+	if (!len)
+		return;
+	if (pp->spans.num) {
+		struct shader_span *last = da_end(pp->spans);
+		if (last->text + last->len == text) {
+			last->len += len;
+			return;
+		}
+	}
+	struct shader_span *span = da_push_back_new(pp->spans);
+	span->text = text;
+	span->len = len;
+}
+
+static bool shader_preprocessor_file(struct shader_preprocessor *pp, const char *file_name);
+
+/* Returns whether the newline ending the #include line should be kept. */
+static bool shader_preprocessor_include(struct shader_preprocessor *pp, const char *file_name, const char *line, size_t line_len)
+{
+	const char *q1 = memchr(line, '"', line_len);
+	const char *q2 = line + line_len;
+	while (q1 && --q2 > q1 && *q2 != '"')
+		;
+	if (!q1 || q2 <= q1) {
+		blog(LOG_WARNING, "[obs-shaderfilter] malformed #include line: %.*s", (int)line_len, line);
+		return false;
+	}
+
+	struct dstr include_path = {0};
+	const char *pos = strrchr(file_name, '/');
+	if (!pos)
+		pos = strrchr(file_name, '\\');
+	if (pos)
+		dstr_ncopy(&include_path, file_name, pos - file_name + 1);
+	dstr_ncat(&include_path, q1 + 1, q2 - q1 - 1);
+
+	char *abs_include_path = os_get_abs_path_ptr(include_path.array);
+	bool resolved = abs_include_path && shader_preprocessor_file(pp, abs_include_path);
+	bfree(abs_include_path);
+	if (!resolved) {
+		blog(LOG_ERROR, "[obs-shaderfilter] failed to resolve #include '%s' from '%s'", include_path.array, file_name);
+		struct dstr error = {0};
+		dstr_printf(&error, "\n// ERROR: failed to resolve #include: %s\n", include_path.array);
+		da_push_back(pp->buffers, &error.array);
+		shader_preprocessor_emit(pp, error.array, error.len);
+	}
+	dstr_free(&include_path);
+	return resolved;
+}
+
+static bool shader_preprocessor_file(struct shader_preprocessor *pp, const char *file_name)
+{
+	for (size_t i = 0; i < pp->visited->num; i++) {
+		if (strcmp(pp->visited->array[i], file_name) == 0) {
+			blog(LOG_WARNING, "[obs-shaderfilter] circular include detected: %s", file_name);
+			return true;
+		}
+	}
+	char *dup = bstrdup(file_name);
+	da_push_back(*pp->visited, &dup);
+
+	char *file_ptr = os_quick_read_utf8_file(file_name);
+	if (file_ptr == NULL) {
+		blog(LOG_WARNING, "[obs-shaderfilter] failed to read file: %s", file_name);
+		return false;
+	}
+	da_push_back(pp->buffers, &file_ptr);
+
+	const char *line = file_ptr;
+	const char *file_end = file_ptr + strlen(file_ptr);
+	for (;;) {
+		const char *nl = memchr(line, '\n', file_end - line);
+		size_t line_len = (nl ? nl : file_end) - line;
+		bool keep_newline = true;
+		if (line_len >= 8 && strncmp(line, "#include", 8) == 0)
+			keep_newline = shader_preprocessor_include(pp, file_name, line, line_len);
+		else
+			shader_preprocessor_emit(pp, line, line_len);
+		if (keep_newline)
+			shader_preprocessor_emit(pp, nl ? nl : "\n", 1);
+		if (!nl)
+			break;
+		line = nl + 1;
+	}
+	return true;
+}
+
+void free_shader_paths(shader_path_array_t *paths)
+{
+	for (size_t i = 0; i < paths->num; i++)
+		bfree(paths->array[i]);
+	da_free(*paths);
+}
+
+char *load_shader_from_file(const char *file_name, shader_path_array_t *dependencies)
+{
+	shader_path_array_t visited;
+	da_init(visited);
+	struct shader_preprocessor pp = {.visited = &visited};
+	da_init(pp.spans);
+	da_init(pp.buffers);
+
+	char *result = NULL;
+	if (shader_preprocessor_file(&pp, file_name)) {
+		size_t total = 0;
+		for (size_t i = 0; i < pp.spans.num; i++)
+			total += pp.spans.array[i].len;
+		result = bmalloc(total + 1);
+		char *out = result;
+		for (size_t i = 0; i < pp.spans.num; i++) {
+			memcpy(out, pp.spans.array[i].text, pp.spans.array[i].len);
+			out += pp.spans.array[i].len;
+		}
+		*out = '\0';
+	}
+
+	for (size_t i = 0; i < pp.buffers.num; i++)
+		bfree(pp.buffers.array[i]);
+	da_free(pp.buffers);
+	da_free(pp.spans);
+
+	if (dependencies)
+		*dependencies = visited;
+	else
+		free_shader_paths(&visited);
+	return result;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <util/darray.h>
+
+typedef DARRAY(char *) shader_path_array_t;
+
+/*
+ * Reads a shader file and expands its #include lines. Returns NULL if the
+ * file cannot be read, otherwise a string the caller frees with bfree.
+ * If dependencies is not NULL it receives the file and every file it
+ * transitively includes; the caller frees it with free_shader_paths().
+ */
+char *load_shader_from_file(const char *file_name, shader_path_array_t *dependencies);
+
+void free_shader_paths(shader_path_array_t *paths);